@@ -0,0 +1,213 @@
+#include "activity_classifier.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    struct Prototype
+    {
+        float mean[ActivityClassifier::DescriptorCount];
+        float sigma[ActivityClassifier::DescriptorCount];
+    };
+
+    // In torso lengths (neck to torso, about 250 mm) and torso lengths per second.
+    //  HandHeight  ArmExtension  HandForward  HandSpeed  HandSwing  BodySpeed  KneeHeight
+    const Prototype gPrototypes[ActivityClassifier::ActionCount] = {
+        { { -2.0f, 2.2f, 0.3f, 0.2f, 0.1f, 0.1f, -1.6f }, { 0.6f, 0.5f, 0.6f, 0.5f, 0.4f, 0.5f, 0.5f } }, // Standing
+        { { -2.0f, 2.1f, 0.4f, 1.5f, 0.4f, 3.0f, -1.5f }, { 0.6f, 0.5f, 0.6f, 1.0f, 0.5f, 1.2f, 0.5f } }, // Walking
+        { {  0.8f, 1.8f, 0.6f, 3.0f, 2.5f, 0.1f, -1.6f }, { 0.7f, 0.6f, 0.7f, 1.5f, 1.2f, 0.5f, 0.5f } }, // Waving
+        { { -0.4f, 2.6f, 2.0f, 1.5f, 0.4f, 0.2f, -1.6f }, { 0.8f, 0.4f, 0.7f, 1.0f, 0.5f, 0.5f, 0.5f } }, // Reaching
+        { {  0.0f, 2.7f, 1.8f, 0.2f, 0.1f, 0.1f, -1.6f }, { 0.6f, 0.4f, 0.7f, 0.5f, 0.4f, 0.5f, 0.5f } }, // Pointing
+        { { -1.4f, 1.8f, 0.8f, 0.3f, 0.1f, 0.1f, -0.2f }, { 0.7f, 0.6f, 0.7f, 0.6f, 0.4f, 0.5f, 0.5f } }  // Sitting
+    };
+
+    const float DescriptorTimeConstant = 0.4f;  // seconds
+}
+
+
+// ActivityClassifier
+//
+void ActivityClassifier::update(uint64_t timestamp, const FeatureExtractor &features)
+{
+    timer_.begin();
+
+    int classified = 0;
+    for (int i = 0; i < features.frameUserCount(); ++i)
+    {
+        uint32_t userId = features.frameUser(i);
+        int slot = users_.acquire(userId, timestamp);
+        if (slot < 0) continue; // more users than slots
+
+        classify(users_[slot], features.features(userId), features.hasMotion(userId), timestamp);
+        ++classified;
+    }
+
+    double elapsed = timer_.end();
+    timing_.lastMs = elapsed;
+    timing_.averageMs = timer_.averageMs();
+    timing_.worstMs = std::max(timing_.worstMs, elapsed);
+    timing_.users = classified;
+}
+
+void ActivityClassifier::removeUser(uint32_t userId)
+{
+    users_.remove(userId);
+}
+
+const float *ActivityClassifier::probabilities(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user? user->probabilities : nullptr;
+}
+
+const float *ActivityClassifier::descriptors(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user? user->descriptors : nullptr;
+}
+
+ActivityClassifier::Timing ActivityClassifier::benchmark(int users, int frames)
+{
+    typedef FeatureExtractor FE;
+
+    users = std::min(users, (int)MaxUsers);
+
+    // Random poses and motion in millimeters, new every frame; only the cost matters here
+    ActivityClassifier classifier;
+    std::vector<float> features(users * FE::FeatureCount);
+    Timing timing;
+    uint64_t timestamp = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        timestamp += 33333;
+        for (auto &f : features) f = (rand() % 2001 - 1000) * 0.5f;
+        for (int u = 0; u < users; ++u) features[u * FE::FeatureCount + FE::Distances + FE::TorsoLength] = 250.0f;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int u = 0; u < users; ++u)
+        {
+            int slot = classifier.users_.acquire(u + 1, timestamp);
+            classifier.classify(classifier.users_[slot], &features[u * FE::FeatureCount], true, timestamp);
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        timing.lastMs = elapsed;
+        timing.averageMs += elapsed / frames;
+        timing.worstMs = std::max(timing.worstMs, elapsed);
+    }
+    timing.users = users;
+    return timing;
+}
+
+const char *ActivityClassifier::actionName(int action)
+{
+    static const char *names[ActionCount] = { "Standing", "Walking", "Waving", "Reaching", "Pointing", "Sitting" };
+    return action >= 0 && action < ActionCount? names[action] : "Action";
+}
+
+float ActivityClassifier::valueAtBar(int bar)
+{
+    const float *p = probabilities(focusUser());
+    return p? p[bar] * 100.0f : 0.0f;
+}
+
+void ActivityClassifier::classify(UserState &user, const float *f, bool bHasMotion, uint64_t timestamp)
+{
+    typedef FeatureExtractor FE;
+
+    const float scale = 1.0f / std::max(f[FE::Distances + FE::TorsoLength], 100.0f);
+
+    // Pose
+    float d[DescriptorCount] = { -10.0f, 0.0f, -10.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    const int hands[2] = { FE::LeftHand, FE::RightHand };
+    const int shoulders[2] = { FE::LeftShoulder, FE::RightShoulder };
+    const int armLengths[2] = { FE::LeftShoulderToHand, FE::RightShoulderToHand };
+    for (int h = 0; h < 2; ++h)
+    {
+        d[HandHeight] = std::max(d[HandHeight], (f[FE::RelativeY + hands[h]] - f[FE::RelativeY + shoulders[h]]) * scale);
+        d[ArmExtension] = std::max(d[ArmExtension], f[FE::Distances + armLengths[h]] * scale);
+        d[HandForward] = std::max(d[HandForward], -f[FE::RelativeZ + hands[h]] * scale); // z grows away from the sensor
+    }
+
+    d[KneeHeight] = 0.5f * ((f[FE::RelativeY + FE::LeftKnee] - f[FE::RelativeY + FE::LeftHip]) +
+                            (f[FE::RelativeY + FE::RightKnee] - f[FE::RelativeY + FE::RightHip])) * scale;
+
+    // Motion
+    const float dt = user.bHasPrevious? (timestamp - user.timestamp) * 1e-6f : 0.0f;
+    if (bHasMotion && dt > 0.0f && dt < 0.5f)
+    {
+        // hand velocities relative to the torso
+        int fastest = 0;
+        float fastestSpeed = 0.0f;
+        float sideways[2];
+        for (int h = 0; h < 2; ++h)
+        {
+            float v[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                int block = FE::VelocityX + k * FE::JointCount;
+                v[k] = (f[block + hands[h]] - f[block + FE::Torso]) * scale;
+            }
+            sideways[h] = v[0];
+
+            float speed = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (speed > fastestSpeed)
+            {
+                fastest = h;
+                fastestSpeed = speed;
+            }
+        }
+
+        d[HandSpeed] = fastestSpeed;
+        d[BodySpeed] = std::hypot(f[FE::VelocityX + FE::Torso], f[FE::VelocityZ + FE::Torso]) * scale;
+
+        const float a = 1.0f - std::exp(-dt / DescriptorTimeConstant);
+        user.swingMean += a * (sideways[fastest] - user.swingMean);
+        user.swingSquare += a * (sideways[fastest] * sideways[fastest] - user.swingSquare);
+        d[HandSwing] = std::sqrt(std::max(0.0f, user.swingSquare - user.swingMean * user.swingMean));
+
+        for (int k = 0; k < DescriptorCount; ++k)
+        {
+            user.descriptors[k] += a * (d[k] - user.descriptors[k]);
+        }
+    }
+    else
+    {
+        // first frame, or a gap: start over from the current pose, at rest
+        std::copy(d, d + DescriptorCount, user.descriptors);
+        user.swingMean = user.swingSquare = 0.0f;
+    }
+
+    user.timestamp = timestamp;
+    user.bHasPrevious = true;
+
+    // Scores: log-likelihood under each prototype, then softmax
+    float logL[ActionCount], maxLogL = -INFINITY;
+    for (int c = 0; c < ActionCount; ++c)
+    {
+        float sum = 0.0f;
+        for (int k = 0; k < DescriptorCount; ++k)
+        {
+            float z = (user.descriptors[k] - gPrototypes[c].mean[k]) / gPrototypes[c].sigma[k];
+            sum += z * z;
+        }
+        logL[c] = -0.5f * sum;
+        maxLogL = std::max(maxLogL, logL[c]);
+    }
+
+    float total = 0.0f;
+    for (int c = 0; c < ActionCount; ++c)
+    {
+        user.probabilities[c] = std::exp(logL[c] - maxLogL);
+        total += user.probabilities[c];
+    }
+    for (int c = 0; c < ActionCount; ++c)
+    {
+        user.probabilities[c] /= total;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef activity_classifier_hpp
+#define activity_classifier_hpp
+
+#include <algorithm>
+#include <cstdint>
+
+#include "bargraph_generator.hpp"
+#include "feature_extractor.hpp"
+
+// Activity classifier
+//
+// Streaming classifier behind the bar graph of the bottom panel. Every
+// skeleton frame, the feature vector of each tracked user is reduced to a few
+// pose and motion descriptors, measured in torso lengths so they do not
+// depend on body size or distance to the sensor. The descriptors are smoothed over
+// about half a second and scored against a Gaussian prototype per action;
+// the normalized scores are the action probabilities.
+//
+class ActivityClassifier : public BarGraphGenerator
+{
+public:
+    enum Action { Standing, Walking, Waving, Reaching, Pointing, Sitting, ActionCount };
+
+    enum Descriptor
+    {
+        HandHeight,     // highest hand above its shoulder
+        ArmExtension,   // longest shoulder to hand distance
+        HandForward,    // hand furthest in front of the torso
+        HandSpeed,      // fastest hand, relative to the torso, per second
+        HandSwing,      // deviation of the sideways hand velocity: high when waving
+        BodySpeed,      // horizontal torso speed, per second
+        KneeHeight,     // knees relative to hips: near 0 when sitting
+        DescriptorCount
+    };
+
+    static const int MaxUsers = FeatureExtractor::MaxUsers;
+
+    struct Timing
+    {
+        double lastMs = 0.0;
+        double averageMs = 0.0;
+        double worstMs = 0.0;
+        int users = 0;          // users classified in the last update
+    };
+
+    /** Classify the users of the last feature update. 'timestamp' is the sensor time in microseconds. */
+    void update(uint64_t timestamp, const FeatureExtractor &features);
+    void removeUser(uint32_t userId);
+
+    /** ActionCount probabilities summing to 1, or nullptr if the user is not tracked */
+    const float *probabilities(uint32_t userId) const;
+
+    /** DescriptorCount smoothed descriptors, or nullptr if the user is not tracked */
+    const float *descriptors(uint32_t userId) const;
+
+    /** User shown in the bar graph, the features' focus user so every panel shows the same person */
+    uint32_t focusUser() const { return focusUser_; }
+    void setFocusUser(uint32_t userId) { focusUser_ = userId; }
+
+    const Timing &timing() const { return timing_; }
+
+    static const char *actionName(int action);
+
+    /** Classify 'users' users with synthetic features for 'frames' frames; per-frame times */
+    static Timing benchmark(int users, int frames);
+
+// BarGraphGenerator
+    void update() override {}
+    unsigned int numBars() override { return ActionCount; }
+    float valueAtBar(int bar) override;
+    const char *barLabel(int bar) override { return actionName(bar); }
+
+private:
+    struct UserState
+    {
+        UserState() { std::fill(probabilities, probabilities + ActionCount, 1.0f / ActionCount); }
+
+        uint64_t timestamp = 0; // of the previous frame
+        bool bHasPrevious = false;
+        float swingMean = 0.0f, swingSquare = 0.0f;
+        float descriptors[DescriptorCount];
+        float probabilities[ActionCount];
+    };
+
+    void classify(UserState &user, const float *features, bool bHasMotion, uint64_t timestamp);
+
+    UserSlots<UserState, MaxUsers> users_;
+    uint32_t focusUser_ = 0;
+    UpdateTimer timer_;
+    Timing timing_;
+};
+
+#endif /* activity_classifier_hpp */
@@ -0,0 +1,223 @@
+#include "activity_states.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    typedef ActivityClassifier AC;
+
+    const float LogZero = -1e30f;   // finite, so sums stay well defined
+    const float MinProbability = 1e-4f;
+
+    // Rate of change of the driving descriptor, per phase, in torso lengths per second
+    const float PhaseRateMean[ActivityStates::PhaseCount] = { 1.0f, 0.0f, -1.0f };
+    const float PhaseRateSigma[ActivityStates::PhaseCount] = { 0.8f, 0.6f, 0.8f };
+
+    /** The descriptor whose rate tells the phases of an action apart, and its sign */
+    struct Driver
+    {
+        AC::Descriptor descriptor;
+        float sign;
+    };
+    const Driver gDrivers[AC::ActionCount] = {
+        { AC::BodySpeed, -1.0f },   // Standing: coming to rest
+        { AC::BodySpeed, 1.0f },    // Walking
+        { AC::HandHeight, 1.0f },   // Waving
+        { AC::HandForward, 1.0f },  // Reaching
+        { AC::ArmExtension, 1.0f }, // Pointing
+        { AC::KneeHeight, 1.0f }    // Sitting: knees come up to the hips
+    };
+
+    const char *gStateNames[ActivityStates::StateCount] = {
+        "Unknown",
+        "Settling",     "Still",        "Shifting",
+        "Walk start",   "Walking",      "Walk stop",
+        "Hand up",      "Waving",       "Hand down",
+        "Reach out",    "Reaching",     "Reach back",
+        "Arm up",       "Pointing",     "Arm down",
+        "Sitting down", "Seated",       "Getting up"
+    };
+}
+
+
+// ActivityStates
+//
+ActivityStates::ActivityStates()
+{
+    const int S = StateCount;
+    const int A = AC::ActionCount;
+
+    float from[S][S] = {}; // [from][to], easier to fill by rows
+    from[0][0] = 0.90f;
+    for (int a = 0; a < A; ++a)
+    {
+        int onset = stateOf(a, Onset), hold = stateOf(a, Hold), release = stateOf(a, Release);
+        from[0][onset] = 0.10f / A;
+
+        from[onset][onset] = 0.80f;
+        from[onset][hold] = 0.15f;
+        from[onset][0] = 0.05f;
+
+        from[hold][hold] = 0.95f;
+        from[hold][release] = 0.04f;
+        from[hold][0] = 0.01f;
+
+        from[release][release] = 0.80f;
+        from[release][0] = 0.10f;
+        for (int b = 0; b < A; ++b)
+        {
+            if (b != a) from[release][stateOf(b, Onset)] = 0.10f / (A - 1);
+        }
+    }
+
+    for (int j = 0; j < S; ++j)
+    {
+        for (int i = 0; i < S; ++i)
+        {
+            transition_[j][i] = from[i][j];
+            logTransition_[j][i] = from[i][j] > 0.0f? std::log(from[i][j]) : LogZero;
+        }
+    }
+}
+
+void ActivityStates::update(uint64_t timestamp, uint32_t userId, const float *probabilities, const float *descriptors)
+{
+    if (!probabilities || !descriptors) return;
+
+    int slot = decoders_.acquire(userId, timestamp);
+    if (slot < 0) return;
+    Decoder *decoder = &decoders_[slot];
+
+    timer_.begin();
+
+    const int S = StateCount;
+    float logE[S];
+    emissions(*decoder, timestamp, probabilities, descriptors, logE);
+
+    if (decoder->frames == 0)
+    {
+        const float logPriorUnknown = std::log(0.5f), logPriorOther = std::log(0.5f / (S - 1));
+        for (int j = 0; j < S; ++j)
+        {
+            decoder->alpha[j] = decoder->delta[j] = (j == 0? logPriorUnknown : logPriorOther) + logE[j];
+        }
+    }
+    else
+    {
+        // Forward: alpha'(j) = e(j) + log sum_i exp(alpha(i)) T(i, j), as a matrix-vector product in linear space
+        float maxAlpha = *std::max_element(decoder->alpha, decoder->alpha + S);
+        float w[S];
+        for (int i = 0; i < S; ++i) w[i] = std::exp(decoder->alpha[i] - maxAlpha);
+
+        float alpha[S];
+        for (int j = 0; j < S; ++j)
+        {
+            const float *t = transition_[j];
+            float sum = 0.0f;
+            for (int i = 0; i < S; ++i) sum += t[i] * w[i];
+            alpha[j] = logE[j] + maxAlpha + std::log(std::max(sum, 1e-30f));
+        }
+
+        // Viterbi: delta'(j) = e(j) + max_i delta(i) + log T(i, j)
+        uint8_t *backPointers = decoder->backPointers[decoder->frames % Lag];
+        float delta[S];
+        for (int j = 0; j < S; ++j)
+        {
+            const float *logT = logTransition_[j];
+            float best = LogZero;
+            int argBest = 0;
+            for (int i = 0; i < S; ++i)
+            {
+                const float score = decoder->delta[i] + logT[i];
+                if (score > best)
+                {
+                    best = score;
+                    argBest = i;
+                }
+            }
+
+            delta[j] = logE[j] + best;
+            backPointers[j] = (uint8_t)argBest;
+        }
+
+        std::copy(alpha, alpha + S, decoder->alpha);
+        std::copy(delta, delta + S, decoder->delta);
+    }
+
+    // Renormalize: alpha to a log posterior, delta relative to its best
+    float maxAlpha = *std::max_element(decoder->alpha, decoder->alpha + S);
+    float sum = 0.0f;
+    for (int j = 0; j < S; ++j) sum += std::exp(decoder->alpha[j] - maxAlpha);
+    float logNorm = maxAlpha + std::log(sum);
+    for (int j = 0; j < S; ++j)
+    {
+        decoder->alpha[j] -= logNorm;
+        decoder->posterior[j] = std::exp(decoder->alpha[j]);
+    }
+
+    int state = (int)(std::max_element(decoder->delta, decoder->delta + S) - decoder->delta);
+    float maxDelta = decoder->delta[state];
+    for (int j = 0; j < S; ++j) decoder->delta[j] -= maxDelta;
+
+    // Fixed lag: follow the back pointers to the state 'Lag - 1' frames ago
+    const int steps = std::min(decoder->frames, Lag - 1);
+    for (int k = 0; k < steps; ++k)
+    {
+        state = decoder->backPointers[(decoder->frames - k) % Lag][state];
+    }
+    decoder->decoded = state;
+    ++decoder->frames;
+
+    timer_.end();
+}
+
+void ActivityStates::removeUser(uint32_t userId)
+{
+    decoders_.remove(userId);
+}
+
+int ActivityStates::decodedState(uint32_t userId) const
+{
+    const Decoder *decoder = decoders_.state(userId);
+    return decoder && decoder->frames > 0? decoder->decoded : -1;
+}
+
+const float *ActivityStates::posterior(uint32_t userId) const
+{
+    const Decoder *decoder = decoders_.state(userId);
+    return decoder && decoder->frames > 0? decoder->posterior : nullptr;
+}
+
+bool ActivityStates::isStateActive(int state)
+{
+    return decodedState(focusUser()) == state;
+}
+
+const char *ActivityStates::stateName(int state)
+{
+    return state >= 0 && state < StateCount? gStateNames[state] : "State";
+}
+
+void ActivityStates::emissions(Decoder &decoder, uint64_t timestamp, const float *probabilities, const float *descriptors, float *logE)
+{
+    const float dt = decoder.frames > 0? (timestamp - decoder.timestamp) * 1e-6f : 0.0f;
+    const bool bRates = dt > 0.0f && dt < 0.5f;
+
+    logE[0] = std::log(1.0f / AC::ActionCount) - 0.5f;
+    for (int a = 0; a < AC::ActionCount; ++a)
+    {
+        const Driver &driver = gDrivers[a];
+        float rate = bRates? driver.sign * (descriptors[driver.descriptor] - decoder.descriptors[driver.descriptor]) / dt : 0.0f;
+        float logP = std::log(std::max(probabilities[a], MinProbability));
+
+        for (int phase = 0; phase < PhaseCount; ++phase)
+        {
+            float z = (rate - PhaseRateMean[phase]) / PhaseRateSigma[phase];
+            logE[stateOf(a, (Phase)phase)] = logP - 0.5f * z * z;
+        }
+    }
+
+    std::copy(descriptors, descriptors + AC::DescriptorCount, decoder.descriptors);
+    decoder.timestamp = timestamp;
+}
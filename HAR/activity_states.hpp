@@ -0,0 +1,82 @@
+#ifndef activity_states_hpp
+#define activity_states_hpp
+
+#include <cstdint>
+
+#include "states_info.hpp"
+#include "activity_classifier.hpp"
+
+// Activity states
+//
+// Hidden Markov model over 19 states: 'Unknown', and for each action of the
+// ActivityClassifier an onset, a hold and a release phase. Emissions combine
+// the classifier probability of the state's action with the rate of change
+// of the descriptor that drives the action (hand height for waving, body
+// speed for walking...), which tells the phases apart.
+//
+// Each tracked user has a decoder that runs, once per skeleton frame:
+//  - forward filtering, giving the current state posterior
+//  - Viterbi with a fixed lag, giving the most likely state 'Lag - 1' frames ago
+//    (the ring holds 'Lag' sets of back pointers, the newest included),
+//    which is what the states panel shows
+// Both are O(S^2) per frame, in log space, with all storage preallocated.
+//
+class ActivityStates : public StatesInfo
+{
+public:
+    enum Phase { Onset, Hold, Release, PhaseCount };
+
+    static const int StateCount = 1 + ActivityClassifier::ActionCount * PhaseCount;
+    static const int Lag = 16;
+    static const int MaxUsers = ActivityClassifier::MaxUsers;
+
+    ActivityStates();
+
+    /** Decode one frame of a user from the classifier output. 'timestamp' in microseconds. */
+    void update(uint64_t timestamp, uint32_t userId, const float *probabilities, const float *descriptors);
+    void removeUser(uint32_t userId);
+
+    /** Decoded state of a user, 'Lag - 1' frames behind, or -1 if the user is not tracked */
+    int decodedState(uint32_t userId) const;
+
+    /** Filtered posterior of the current frame, StateCount values summing to 1, or nullptr */
+    const float *posterior(uint32_t userId) const;
+
+    /** User shown in the states panel, the features' focus user so every panel shows the same person */
+    uint32_t focusUser() const { return focusUser_; }
+    void setFocusUser(uint32_t userId) { focusUser_ = userId; }
+
+    double averageUpdateMs() const { return timer_.averageMs(); }
+
+    static int stateOf(int action, Phase phase) { return 1 + action * PhaseCount + phase; }
+
+// StatesInfo
+    unsigned int numStates() override { return StateCount; }
+    bool isStateActive(int state) override;
+    const char *stateName(int state) override;
+
+private:
+    struct Decoder
+    {
+        uint64_t timestamp = 0; // of the previous frame
+        int frames = 0;
+        float descriptors[ActivityClassifier::DescriptorCount]; // of the previous frame
+
+        float alpha[StateCount];                // forward log-probabilities
+        float posterior[StateCount];            // exp(alpha)
+        float delta[StateCount];                // Viterbi log-scores
+        uint8_t backPointers[Lag][StateCount];  // ring, by frame
+        int decoded = 0;
+    };
+
+    void emissions(Decoder &decoder, uint64_t timestamp, const float *probabilities, const float *descriptors, float *logE);
+
+    float transition_[StateCount][StateCount];      // [to][from], probabilities
+    float logTransition_[StateCount][StateCount];   // [to][from], log-probabilities
+
+    UserSlots<Decoder, MaxUsers> decoders_;
+    uint32_t focusUser_ = 0;
+    UpdateTimer timer_;
+};
+
+#endif /* activity_states_hpp */
@@ -13,6 +13,8 @@ struct BarGraphGenerator
     
     /** Return value in range 0 to 100 */
     virtual float valueAtBar(int bar) = 0;
+    
+    virtual const char *barLabel(int /*bar*/) { return "Action"; }
 };
 
 
@@ -0,0 +1,230 @@
+#include "feature_extractor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <XnOpenNI.h>
+
+namespace
+{
+    typedef FeatureExtractor FE;
+
+    struct Pair { int a, b; const char *name; };
+    const Pair gPairs[FE::DistanceCount] = {
+        { FE::Neck, FE::Torso, "TorsoLength" },
+        { FE::Head, FE::LeftHand, "HeadToLeftHand" },
+        { FE::Head, FE::RightHand, "HeadToRightHand" },
+        { FE::LeftHand, FE::RightHand, "HandToHand" },
+        { FE::LeftShoulder, FE::LeftHand, "LeftShoulderToHand" },
+        { FE::RightShoulder, FE::RightHand, "RightShoulderToHand" },
+        { FE::LeftFoot, FE::RightFoot, "FootToFoot" }
+    };
+
+    struct Triple { int a, center, b; const char *name; };
+    const Triple gTriples[FE::AngleCount] = {
+        { FE::LeftShoulder, FE::LeftElbow, FE::LeftHand, "LeftElbowAngle" },
+        { FE::RightShoulder, FE::RightElbow, FE::RightHand, "RightElbowAngle" },
+        { FE::LeftElbow, FE::LeftShoulder, FE::LeftHip, "LeftShoulderAngle" },
+        { FE::RightElbow, FE::RightShoulder, FE::RightHip, "RightShoulderAngle" },
+        { FE::LeftShoulder, FE::LeftHip, FE::LeftKnee, "LeftHipAngle" },
+        { FE::RightShoulder, FE::RightHip, FE::RightKnee, "RightHipAngle" },
+        { FE::LeftHip, FE::LeftKnee, FE::LeftFoot, "LeftKneeAngle" },
+        { FE::RightHip, FE::RightKnee, FE::RightFoot, "RightKneeAngle" }
+    };
+
+    const int PairLanes = 8;    // DistanceCount and AngleCount, padded
+    static_assert(FE::DistanceCount <= PairLanes && FE::AngleCount <= PairLanes, "pair tables outgrew their lanes");
+    static_assert(FE::JointCount <= FE::Lanes, "joints outgrew their lanes");
+
+    const float MaxFrameGap = 0.5f;         // seconds: longer gaps restart the motion features
+    const float MinConfidence = 0.5f;
+}
+
+
+// FeatureExtractor
+//
+void FeatureExtractor::update(uint64_t timestamp, const session::SkeletonRecord *users, int count)
+{
+    timer_.begin();
+
+    frameUserCount_ = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        int slot = users_.acquire(users[i].userId, timestamp);
+        if (slot < 0) continue; // more users than slots
+
+        UserState &user = users_[slot];
+        if (!extract(user, users[i], timestamp)) continue;
+        frameUsers_[frameUserCount_++] = users[i].userId;
+
+        if (log_.is_open()) log(timestamp, users[i].userId, user);
+    }
+
+    timer_.end();
+}
+
+void FeatureExtractor::removeUser(uint32_t userId)
+{
+    users_.remove(userId);
+}
+
+const float *FeatureExtractor::features(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user && user->bHasPrevious? user->features : nullptr;
+}
+
+bool FeatureExtractor::hasMotion(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user && user->bHasVelocity;
+}
+
+uint32_t FeatureExtractor::focusUser() const
+{
+    uint32_t focus = 0;
+    for (int slot = 0; slot < MaxUsers; ++slot)
+    {
+        uint32_t userId = users_.userId(slot);
+        if (userId != 0 && users_[slot].bHasPrevious && (focus == 0 || userId < focus)) focus = userId;
+    }
+    return focus;
+}
+
+bool FeatureExtractor::openLog(const std::string &filename)
+{
+    log_.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (!log_)
+    {
+        fprintf(stderr, "FeatureExtractor: cannot open %s\n", filename.c_str());
+        return false;
+    }
+
+    log_ << "timestamp,user";
+    for (int k = 0; k < FeatureCount; ++k) log_ << "," << featureName(k);
+    log_ << "\n";
+    return true;
+}
+
+const char *FeatureExtractor::featureName(int feature)
+{
+    // "LeftHand.vy" style names, built once
+    static std::string names[FeatureCount];
+    if (names[0].empty())
+    {
+        const char *blocks[9] = { ".x", ".y", ".z", ".vx", ".vy", ".vz", ".ax", ".ay", ".az" };
+        for (int b = 0; b < 9; ++b)
+        {
+            for (int j = 0; j < JointCount; ++j) names[b * JointCount + j] = std::string(skeleton::Joints[j].name) + blocks[b];
+        }
+        for (int k = 0; k < DistanceCount; ++k) names[Distances + k] = gPairs[k].name;
+        for (int k = 0; k < AngleCount; ++k) names[Angles + k] = gTriples[k].name;
+    }
+    return feature >= 0 && feature < FeatureCount? names[feature].c_str() : "Feature";
+}
+
+bool FeatureExtractor::extract(UserState &user, const session::SkeletonRecord &record, uint64_t timestamp)
+{
+    const session::SkeletonJoint &neck = record.joints[XN_SKEL_NECK - 1];
+    const session::SkeletonJoint &torso = record.joints[XN_SKEL_TORSO - 1];
+    if (neck.confidence < MinConfidence || torso.confidence < MinConfidence) return false;
+
+    float *f = user.features;
+
+    // Gather the joints, SoA; padding lanes repeat the torso so they stay finite
+    float p[3][Lanes];
+    for (int j = 0; j < Lanes; ++j)
+    {
+        const session::SkeletonJoint &joint = record.joints[(j < JointCount? skeleton::Joints[j].id : XN_SKEL_TORSO) - 1];
+        p[0][j] = joint.x;
+        p[1][j] = joint.y;
+        p[2][j] = joint.z;
+    }
+
+    // Relative to the torso
+    for (int d = 0; d < 3; ++d)
+    {
+        float rel[Lanes];
+        const float origin = p[d][Torso];
+        for (int j = 0; j < Lanes; ++j) rel[j] = p[d][j] - origin;
+        std::copy(rel, rel + JointCount, f + RelativeX + d * JointCount);
+    }
+
+    // Velocities and accelerations, by finite differences
+    const float dt = user.bHasPrevious? (timestamp - user.timestamp) * 1e-6f : 0.0f;
+    if (dt > 0.0f && dt < MaxFrameGap)
+    {
+        const float invDt = 1.0f / dt;
+        const float hasVelocity = user.bHasVelocity? 1.0f : 0.0f;
+        for (int d = 0; d < 3; ++d)
+        {
+            float v[Lanes], a[Lanes];
+            for (int j = 0; j < Lanes; ++j)
+            {
+                v[j] = (p[d][j] - user.position[d][j]) * invDt;
+                a[j] = (v[j] - user.velocity[d][j]) * invDt * hasVelocity;
+                user.velocity[d][j] = v[j];
+            }
+            std::copy(v, v + JointCount, f + VelocityX + d * JointCount);
+            std::copy(a, a + JointCount, f + AccelerationX + d * JointCount);
+        }
+        user.bHasVelocity = true;
+    }
+    else
+    {
+        // first frame, or a gap: at rest
+        std::fill(f + VelocityX, f + Distances, 0.0f);
+        std::fill(&user.velocity[0][0], &user.velocity[0][0] + 3 * Lanes, 0.0f);
+        user.bHasVelocity = false;
+    }
+
+    // Distances: gather both ends of every pair, then one pass
+    {
+        float u[3][PairLanes] = {};
+        for (int d = 0; d < 3; ++d)
+        {
+            for (int k = 0; k < DistanceCount; ++k) u[d][k] = p[d][gPairs[k].a] - p[d][gPairs[k].b];
+        }
+        float dist[PairLanes];
+        for (int k = 0; k < PairLanes; ++k)
+        {
+            dist[k] = std::sqrt(u[0][k] * u[0][k] + u[1][k] * u[1][k] + u[2][k] * u[2][k]);
+        }
+        std::copy(dist, dist + DistanceCount, f + Distances);
+    }
+
+    // Angles: the two limbs of every triple, then one pass
+    {
+        float u[3][PairLanes] = {}, v[3][PairLanes] = {};
+        for (int d = 0; d < 3; ++d)
+        {
+            for (int k = 0; k < AngleCount; ++k)
+            {
+                u[d][k] = p[d][gTriples[k].a] - p[d][gTriples[k].center];
+                v[d][k] = p[d][gTriples[k].b] - p[d][gTriples[k].center];
+            }
+        }
+        float cosine[PairLanes];
+        for (int k = 0; k < PairLanes; ++k)
+        {
+            float dot = u[0][k] * v[0][k] + u[1][k] * v[1][k] + u[2][k] * v[2][k];
+            float uu = u[0][k] * u[0][k] + u[1][k] * u[1][k] + u[2][k] * u[2][k];
+            float vv = v[0][k] * v[0][k] + v[1][k] * v[1][k] + v[2][k] * v[2][k];
+            cosine[k] = std::min(std::max(dot / std::sqrt(std::max(uu * vv, 1e-6f)), -1.0f), 1.0f);
+        }
+        for (int k = 0; k < AngleCount; ++k) f[Angles + k] = std::acos(cosine[k]);
+    }
+
+    std::copy(&p[0][0], &p[0][0] + 3 * Lanes, &user.position[0][0]);
+    user.timestamp = timestamp;
+    user.bHasPrevious = true;
+    return true;
+}
+
+void FeatureExtractor::log(uint64_t timestamp, uint32_t userId, const UserState &user)
+{
+    log_ << timestamp << "," << userId;
+    for (int k = 0; k < FeatureCount; ++k) log_ << "," << user.features[k];
+    log_ << "\n";
+}
@@ -0,0 +1,142 @@
+#ifndef feature_extractor_hpp
+#define feature_extractor_hpp
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "session.hpp"
+#include "skeleton_topology.hpp"
+#include "user_slots.hpp"
+
+// Feature extractor
+//
+// First stage after skeleton tracking. Once per skeleton frame, every
+// tracked user is reduced to a feature vector with a fixed layout, which the
+// classifier, the live graphs and the feature log all read instead of going
+// back to the joints:
+//  - position of each joint relative to the torso (millimeters)
+//  - velocity and acceleration of each joint (millimeters per second, per second)
+//  - distances between pairs of joints (millimeters)
+//  - angles at the elbows, shoulders, hips and knees (radians)
+//
+// Joints are laid out SoA, one axis after the other, padded to 'Lanes' so
+// every per-joint loop runs over whole vectors; pair and triple tables are
+// gathered into the same layout before the distance and angle math.
+//
+class FeatureExtractor
+{
+public:
+    /** Positions in skeleton::Joints, which also sets the order of the joint features */
+    enum Joint
+    {
+        Head = skeleton::indexOf(XN_SKEL_HEAD),
+        Neck = skeleton::indexOf(XN_SKEL_NECK),
+        Torso = skeleton::indexOf(XN_SKEL_TORSO),
+        LeftShoulder = skeleton::indexOf(XN_SKEL_LEFT_SHOULDER),
+        LeftElbow = skeleton::indexOf(XN_SKEL_LEFT_ELBOW),
+        LeftHand = skeleton::indexOf(XN_SKEL_LEFT_HAND),
+        RightShoulder = skeleton::indexOf(XN_SKEL_RIGHT_SHOULDER),
+        RightElbow = skeleton::indexOf(XN_SKEL_RIGHT_ELBOW),
+        RightHand = skeleton::indexOf(XN_SKEL_RIGHT_HAND),
+        LeftHip = skeleton::indexOf(XN_SKEL_LEFT_HIP),
+        LeftKnee = skeleton::indexOf(XN_SKEL_LEFT_KNEE),
+        LeftFoot = skeleton::indexOf(XN_SKEL_LEFT_FOOT),
+        RightHip = skeleton::indexOf(XN_SKEL_RIGHT_HIP),
+        RightKnee = skeleton::indexOf(XN_SKEL_RIGHT_KNEE),
+        RightFoot = skeleton::indexOf(XN_SKEL_RIGHT_FOOT),
+        JointCount = skeleton::JointCount
+    };
+
+    enum Distance
+    {
+        TorsoLength,        // neck to torso
+        HeadToLeftHand,
+        HeadToRightHand,
+        HandToHand,
+        LeftShoulderToHand,
+        RightShoulderToHand,
+        FootToFoot,
+        DistanceCount
+    };
+
+    enum Angle
+    {
+        LeftElbowAngle,     // shoulder, elbow, hand
+        RightElbowAngle,
+        LeftShoulderAngle,  // elbow, shoulder, hip
+        RightShoulderAngle,
+        LeftHipAngle,       // shoulder, hip, knee
+        RightHipAngle,
+        LeftKneeAngle,      // hip, knee, foot
+        RightKneeAngle,
+        AngleCount
+    };
+
+    // Offsets in the feature vector; a joint's value is at offset + joint
+    enum Layout
+    {
+        RelativeX = 0,
+        RelativeY = RelativeX + JointCount,
+        RelativeZ = RelativeY + JointCount,
+        VelocityX = RelativeZ + JointCount,
+        VelocityY = VelocityX + JointCount,
+        VelocityZ = VelocityY + JointCount,
+        AccelerationX = VelocityZ + JointCount,
+        AccelerationY = AccelerationX + JointCount,
+        AccelerationZ = AccelerationY + JointCount,
+        Distances = AccelerationZ + JointCount,
+        Angles = Distances + DistanceCount,
+        FeatureCount = Angles + AngleCount
+    };
+
+    static const int Lanes = 16;        // JointCount, padded
+    static const int MaxUsers = MaxTrackedUsers;
+
+    /** Extract the features of one skeleton frame. 'timestamp' is the sensor time in microseconds. */
+    void update(uint64_t timestamp, const session::SkeletonRecord *users, int count);
+    void removeUser(uint32_t userId);
+
+    /** Users extracted in the last update, in skeleton order */
+    int frameUserCount() const { return frameUserCount_; }
+    uint32_t frameUser(int i) const { return frameUsers_[i]; }
+
+    /** FeatureCount values, or nullptr if the user is not tracked */
+    const float *features(uint32_t userId) const;
+
+    /** Whether the velocities (and accelerations) of a user come from consecutive frames */
+    bool hasMotion(uint32_t userId) const;
+
+    /** User shown in the graphs and panels: the tracked user with the lowest id, 0 if none */
+    uint32_t focusUser() const;
+
+    /** Append every extracted vector to a CSV file, one line per user and frame */
+    bool openLog(const std::string &filename);
+
+    double averageUpdateMs() const { return timer_.averageMs(); }
+
+    static const char *featureName(int feature);
+
+private:
+    struct UserState
+    {
+        uint64_t timestamp = 0; // of the previous frame
+        bool bHasPrevious = false;
+        bool bHasVelocity = false;
+        float position[3][Lanes];
+        float velocity[3][Lanes];
+        float features[FeatureCount];
+    };
+
+    bool extract(UserState &user, const session::SkeletonRecord &record, uint64_t timestamp);
+    void log(uint64_t timestamp, uint32_t userId, const UserState &user);
+
+    UserSlots<UserState, MaxUsers> users_;
+    uint32_t frameUsers_[MaxUsers];
+    int frameUserCount_ = 0;
+
+    std::ofstream log_;
+    UpdateTimer timer_;
+};
+
+#endif /* feature_extractor_hpp */
@@ -0,0 +1,203 @@
+#include "gap_filler.hpp"
+#include "skeleton_topology.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const float MaxFrameGap = 0.5f;         // seconds: longer gaps restart the velocity of a joint
+    const float MinConfidence = 0.5f;
+    const float VelocitySmoothing = 0.5f;   // weight of the newest finite difference
+}
+
+
+// GapFiller
+//
+void GapFiller::update(uint64_t timestamp, const session::SkeletonRecord *users, int count)
+{
+    timer_.begin();
+
+    settled_.clear();
+    filledJoints_ = 0;
+    count = std::min(count, (int)MaxUsers);
+
+    for (int i = 0; i < count; ++i)
+    {
+        // a stale user still has frames to settle
+        int slot = users_.acquire(users[i].userId, timestamp, [this](int stale) {
+            while (users_[stale].count > 0) settle(users_[stale]);
+        });
+        if (slot < 0)
+        {
+            filled_[i] = users[i]; // more users than slots
+            continue;
+        }
+        UserState &user = users_[slot];
+
+        Frame frame;
+        frame.timestamp = timestamp;
+        frame.record = users[i];
+        for (int j = 0; j < JointCount; ++j)
+        {
+            frame.quality[j] = frame.record.joints[j].confidence >= MinConfidence? Measured : Missing;
+        }
+
+        // Live: extrapolate now, from what came before
+        user.live = frame;
+        for (int j = 0; j < JointCount; ++j)
+        {
+            if (frame.quality[j] == Measured)
+            {
+                track(user.liveTracks[j], frame.record.joints[j], timestamp);
+            }
+            else if (extrapolate(user.liveTracks[j], timestamp, user.live.record.joints[j]))
+            {
+                user.live.quality[j] = Extrapolated;
+                ++filledJoints_;
+            }
+        }
+        filled_[i] = user.live.record;
+
+        // Settled: wait for LookAhead more frames
+        user.window[(user.first + user.count) % (LookAhead + 1)] = frame;
+        if (++user.count == LookAhead + 1) settle(user);
+    }
+
+    timer_.end();
+}
+
+void GapFiller::removeUser(uint32_t userId)
+{
+    users_.remove(userId, [this](int slot) {
+        while (users_[slot].count > 0) settle(users_[slot]);
+    });
+}
+
+const GapFiller::Frame *GapFiller::live(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user? &user->live : nullptr;
+}
+
+bool GapFiller::position(uint32_t userId, XnSkeletonJoint joint, XnPoint3D &position, Quality &quality) const
+{
+    const Frame *frame = live(userId);
+    int j = joint - 1;
+    if (!frame || j < 0 || j >= JointCount) return false;
+
+    quality = frame->quality[j];
+    position.X = frame->record.joints[j].x;
+    position.Y = frame->record.joints[j].y;
+    position.Z = frame->record.joints[j].z;
+    return quality != Missing;
+}
+
+bool GapFiller::openLog(const std::string &filename)
+{
+    log_.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (!log_)
+    {
+        fprintf(stderr, "GapFiller: cannot open %s\n", filename.c_str());
+        return false;
+    }
+
+    log_ << "timestamp,user";
+    skeleton::forEachJoint(skeleton::FullBody, [&](const skeleton::Joint &joint) {
+        const char *name = joint.name;
+        log_ << "," << name << ".x," << name << ".y," << name << ".z," << name << ".q";
+    });
+    log_ << "\n";
+    return true;
+}
+
+void GapFiller::track(Track &track, const session::SkeletonJoint &joint, uint64_t timestamp)
+{
+    const float p[3] = { joint.x, joint.y, joint.z };
+    const float dt = track.bValid? (timestamp - track.timestamp) * 1e-6f : 0.0f;
+    for (int d = 0; d < 3; ++d)
+    {
+        if (dt > 0.0f && dt < MaxFrameGap)
+        {
+            float v = (p[d] - track.position[d]) / dt;
+            track.velocity[d] += VelocitySmoothing * (v - track.velocity[d]);
+        }
+        else if (dt != 0.0f || !track.bValid)
+        {
+            track.velocity[d] = 0.0f; // first measurement, or after a gap
+        }
+        track.position[d] = p[d];
+    }
+    track.timestamp = timestamp;
+    track.bValid = true;
+}
+
+bool GapFiller::extrapolate(const Track &track, uint64_t timestamp, session::SkeletonJoint &joint) const
+{
+    if (!track.bValid || timestamp < track.timestamp) return false;
+
+    const float dt = (timestamp - track.timestamp) * 1e-6f;
+    if (dt > settings.maxExtrapolation) return false;
+
+    joint.x = track.position[0] + track.velocity[0] * dt;
+    joint.y = track.position[1] + track.velocity[1] * dt;
+    joint.z = track.position[2] + track.velocity[2] * dt;
+    return true;
+}
+
+void GapFiller::settle(UserState &user)
+{
+    const int size = LookAhead + 1;
+    Frame &frame = user.window[user.first];
+
+    for (int j = 0; j < JointCount; ++j)
+    {
+        session::SkeletonJoint &joint = frame.record.joints[j];
+        Track &previous = user.settledTracks[j];
+        if (frame.quality[j] == Measured)
+        {
+            track(previous, joint, frame.timestamp);
+            continue;
+        }
+
+        // Next measurement in the window
+        const Frame *next = nullptr;
+        for (int k = 1; k < user.count && !next; ++k)
+        {
+            const Frame &later = user.window[(user.first + k) % size];
+            if (later.quality[j] == Measured) next = &later;
+        }
+
+        if (previous.bValid && next && (next->timestamp - previous.timestamp) * 1e-6f <= settings.maxInterpolation)
+        {
+            const session::SkeletonJoint &to = next->record.joints[j];
+            float u = (float)(frame.timestamp - previous.timestamp) / (float)(next->timestamp - previous.timestamp);
+            joint.x = previous.position[0] + u * (to.x - previous.position[0]);
+            joint.y = previous.position[1] + u * (to.y - previous.position[1]);
+            joint.z = previous.position[2] + u * (to.z - previous.position[2]);
+            frame.quality[j] = Interpolated;
+        }
+        else if (extrapolate(previous, frame.timestamp, joint))
+        {
+            frame.quality[j] = Extrapolated;
+        }
+    }
+
+    if (log_.is_open()) log(frame);
+    settled_.push_back(frame);
+
+    user.first = (user.first + 1) % size;
+    --user.count;
+}
+
+void GapFiller::log(const Frame &frame)
+{
+    log_ << frame.timestamp << "," << frame.record.userId;
+    skeleton::forEachJoint(skeleton::FullBody, [&](const skeleton::Joint &tracked) {
+        const int j = tracked.id - 1;
+        const session::SkeletonJoint &joint = frame.record.joints[j];
+        if (frame.quality[j] == Missing) log_ << ",,,," << (int)Missing;
+        else log_ << "," << joint.x << "," << joint.y << "," << joint.z << "," << (int)frame.quality[j];
+    });
+    log_ << "\n";
+}
@@ -0,0 +1,105 @@
+#ifndef gap_filler_hpp
+#define gap_filler_hpp
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <XnOpenNI.h>
+
+#include "session.hpp"
+#include "user_slots.hpp"
+
+// Gap filler
+//
+// Fills the joints that tracking reports below confidence 0.5, so what comes
+// after sees a position for every joint of every frame, each tagged with how
+// it was obtained. Two outputs:
+//  - live: the newest frame, gaps extrapolated from the last measurement and
+//    its velocity for up to 'maxExtrapolation' seconds; for drawing, the
+//    hand Histories and the features
+//  - settled: frames that have left a look-ahead window of 'LookAhead'
+//    frames, gaps interpolated between the measurements on either side when
+//    the next one is in the window, extrapolated otherwise; these go to the
+//    joint log, one dense line per user and frame
+// Confidences stay as measured; quality says which joints were filled.
+//
+class GapFiller
+{
+public:
+    enum Quality : uint8_t { Measured, Interpolated, Extrapolated, Missing };
+
+    static const int MaxUsers = MaxTrackedUsers;
+    static const int JointCount = session::SkeletonRecord::JointCount;
+    static const int LookAhead = 6;         // frames, 0.2 s at 30 Hz
+
+    struct Settings
+    {
+        float maxExtrapolation = 0.3f;      // seconds past the last measurement
+        float maxInterpolation = 1.0f;      // seconds between the measurements on either side
+    };
+
+    struct Frame
+    {
+        uint64_t timestamp = 0;             // microseconds
+        session::SkeletonRecord record;
+        Quality quality[JointCount];        // indexed like record.joints
+    };
+
+    Settings settings;
+
+    void update(uint64_t timestamp, const session::SkeletonRecord *users, int count);
+
+    /** Settles the frames still in the window, then forgets the user */
+    void removeUser(uint32_t userId);
+
+    /** This update's records in input order, gaps extrapolated; as many as update() was given */
+    const session::SkeletonRecord *filled() const { return filled_; }
+
+    /** Newest frame of the user, nullptr if unknown */
+    const Frame *live(uint32_t userId) const;
+    bool position(uint32_t userId, XnSkeletonJoint joint, XnPoint3D &position, Quality &quality) const;
+
+    /** Frames settled by the last update and any removeUser since, oldest first */
+    const std::vector<Frame> &settled() const { return settled_; }
+
+    /** Write every settled frame to a CSV file: x, y, z and quality (as a number) of every joint in skeleton::Joints */
+    bool openLog(const std::string &filename);
+
+    int filledJoints() const { return filledJoints_; }  // in the live frames of the last update
+    double averageUpdateMs() const { return timer_.averageMs(); }
+
+private:
+    struct Track
+    {
+        bool bValid = false;
+        uint64_t timestamp = 0;
+        float position[3];
+        float velocity[3];                  // millimeters per second, smoothed
+    };
+
+    struct UserState
+    {
+        Frame live;
+        Track liveTracks[JointCount];       // last measurement of each joint, for the live frame
+        Track settledTracks[JointCount];    // the same, as of the last settled frame
+        Frame window[LookAhead + 1];        // ring, not yet settled
+        int first = 0, count = 0;
+    };
+
+    void track(Track &track, const session::SkeletonJoint &joint, uint64_t timestamp);
+    bool extrapolate(const Track &track, uint64_t timestamp, session::SkeletonJoint &joint) const;
+    void settle(UserState &user);
+    void log(const Frame &frame);
+
+    UserSlots<UserState, MaxUsers> users_;
+    session::SkeletonRecord filled_[MaxUsers];
+    std::vector<Frame> settled_;
+    int filledJoints_ = 0;
+
+    std::ofstream log_;
+    UpdateTimer timer_;
+};
+
+#endif /* gap_filler_hpp */
@@ -0,0 +1,315 @@
+#include "gesture_matcher.hpp"
+#include "subsys.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+    const int L = GestureMatcher::Length;
+    const float Infinity = std::numeric_limits<float>::infinity();
+    const float MinRadius = 30.0f; // millimeters: anything smaller is a hand at rest
+
+    /** Resample 'count' xyz points (AoS) to Length samples (SoA), centered and scaled to unit RMS radius */
+    bool normalize(const float *xyz, int count, float *out)
+    {
+        if (count < 2) return false;
+
+        for (int i = 0; i < L; ++i)
+        {
+            float t = i * (count - 1) / (float)(L - 1);
+            int k = std::min((int)t, count - 2);
+            float f = t - k;
+            for (int d = 0; d < 3; ++d)
+            {
+                out[d * L + i] = xyz[k * 3 + d] * (1.0f - f) + xyz[(k + 1) * 3 + d] * f;
+            }
+        }
+
+        float radius2 = 0.0f;
+        for (int d = 0; d < 3; ++d)
+        {
+            float *v = out + d * L;
+            float mean = 0.0f;
+            for (int i = 0; i < L; ++i) mean += v[i];
+            mean /= L;
+            for (int i = 0; i < L; ++i)
+            {
+                v[i] -= mean;
+                radius2 += v[i] * v[i];
+            }
+        }
+
+        float radius = std::sqrt(radius2 / L);
+        if (radius < MinRadius) return false;
+
+        for (int i = 0; i < 3 * L; ++i) out[i] /= radius;
+        return true;
+    }
+
+    inline float distance2(const float *a, int i, const float *b, int j)
+    {
+        float dx = a[i] - b[j], dy = a[L + i] - b[L + j], dz = a[2 * L + i] - b[2 * L + j];
+        return dx * dx + dy * dy + dz * dz;
+    }
+}
+
+
+// GestureMatcher
+//
+int GestureMatcher::loadLibrary(const std::string &directory)
+{
+    namespace fs = boost::filesystem;
+    if (!fs::is_directory(directory)) return 0;
+
+    int added = 0;
+    std::vector<float> xyz;
+    for (fs::directory_iterator it(directory), end; it != end; ++it)
+    {
+        if (it->path().extension() != ".txt") continue;
+
+        std::ifstream file(it->path().string());
+        xyz.clear();
+        float x, y, z;
+        while (file >> x >> y >> z)
+        {
+            xyz.insert(xyz.end(), { x, y, z });
+        }
+
+        if (addGesture(it->path().stem().string(), xyz.data(), (int)xyz.size() / 3)) ++added;
+    }
+    return added;
+}
+
+bool GestureMatcher::addGesture(const std::string &name, const float *xyz, int count)
+{
+    float normalized[3 * L];
+    if (!normalize(xyz, count, normalized)) return false;
+
+    samples_.insert(samples_.end(), normalized, normalized + 3 * L);
+
+    // Keogh envelope: min and max over the band around each sample
+    for (int d = 0; d < 3; ++d)
+    {
+        const float *v = normalized + d * L;
+        for (int i = 0; i < L; ++i)
+        {
+            int lo = std::max(0, i - Band), hi = std::min(L - 1, i + Band);
+            upper_.push_back(*std::max_element(v + lo, v + hi + 1));
+            lower_.push_back(*std::min_element(v + lo, v + hi + 1));
+        }
+    }
+
+    names_.push_back(name);
+    return true;
+}
+
+bool GestureMatcher::captureGesture(const std::string &directory, const std::string &name, History &history)
+{
+    points_.clear();
+    history.GetWorldPointsNewerThanTime((int)(window::getTime() * 1000.0) - QueryWindowMs, points_);
+    std::reverse(points_.begin(), points_.end()); // oldest first
+
+    if (!addGesture(name, &points_.data()->X, (int)points_.size())) return false;
+
+    boost::filesystem::create_directories(directory);
+    std::ofstream file(directory + "/" + name + ".txt");
+    for (auto &pt : points_)
+    {
+        file << pt.X << " " << pt.Y << " " << pt.Z << "\n";
+    }
+    return true;
+}
+
+void GestureMatcher::update(History &leftHand, History &rightHand)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    stats_.candidates = stats_.prunedKim = stats_.prunedKeogh = stats_.abandoned = 0;
+
+    History *hands[2] = { &leftHand, &rightHand };
+    for (int h = 0; h < 2; ++h)
+    {
+        float query[3 * L];
+        matches_[h] = makeQuery(*hands[h], query)? match(query) : Match();
+    }
+
+    stats_.lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats_.candidates > 0 && stats_.lastMs > 0.0)
+    {
+        stats_.matchesPerSecond = stats_.candidates / (stats_.lastMs * 0.001);
+    }
+}
+
+double GestureMatcher::benchmark(int templateCount, int queries)
+{
+    // Smooth random walks, so envelopes and warping behave like real trajectories
+    auto randomGesture = [](std::vector<float> &xyz) {
+        xyz.resize(60 * 3);
+        float p[3] = {}, v[3] = {};
+        for (int i = 0; i < 60; ++i)
+        {
+            for (int d = 0; d < 3; ++d)
+            {
+                v[d] = v[d] * 0.9f + (rand() % 2001 - 1000) * 0.01f;
+                p[d] += v[d];
+                xyz[i * 3 + d] = p[d];
+            }
+        }
+    };
+
+    GestureMatcher matcher;
+    std::vector<float> xyz;
+    while (matcher.gestureCount() < templateCount)
+    {
+        randomGesture(xyz);
+        matcher.addGesture("", xyz.data(), 60);
+    }
+
+    std::vector<float> queryData;
+    for (int q = 0; q < queries; ++q)
+    {
+        float query[3 * L];
+        do randomGesture(xyz); while (!normalize(xyz.data(), 60, query));
+        queryData.insert(queryData.end(), query, query + 3 * L);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q)
+    {
+        matcher.match(&queryData[q * 3 * L]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return seconds > 0.0? (double)templateCount * queries / seconds : 0.0;
+}
+
+GestureMatcher::Match GestureMatcher::match(const float *query)
+{
+    Match result;
+    float best = threshold * threshold * L; // only matches under the threshold matter
+
+    const int count = gestureCount();
+    stats_.candidates += count;
+
+    for (int g = 0; g < count; ++g)
+    {
+        const float *t = &samples_[g * 3 * L];
+
+        float kim = distance2(query, 0, t, 0) + distance2(query, L - 1, t, L - 1);
+        if (kim >= best)
+        {
+            ++stats_.prunedKim;
+            continue;
+        }
+
+        if (lowerBoundKeogh(query, g, best) >= best)
+        {
+            ++stats_.prunedKeogh;
+            continue;
+        }
+
+        float d = dtw(query, g, best);
+        if (d < best)
+        {
+            best = d;
+            result.gesture = g;
+        }
+        else
+        {
+            ++stats_.abandoned;
+        }
+    }
+
+    if (result.gesture >= 0)
+    {
+        result.distance = std::sqrt(best / L);
+    }
+    return result;
+}
+
+float GestureMatcher::lowerBoundKeogh(const float *query, int gesture, float best) const
+{
+    const float *upper = &upper_[gesture * 3 * L];
+    const float *lower = &lower_[gesture * 3 * L];
+
+    // Blocks of 8 with separate accumulators, so the inner loop vectorizes; abandon between blocks
+    const int Block = 8;
+    float acc[Block] = {};
+    for (int i0 = 0; i0 < L; i0 += Block)
+    {
+        for (int d = 0; d < 3; ++d)
+        {
+            const float *q = query + d * L + i0, *u = upper + d * L + i0, *l = lower + d * L + i0;
+            for (int i = 0; i < Block; ++i)
+            {
+                float e = std::max(q[i] - u[i], 0.0f) + std::max(l[i] - q[i], 0.0f);
+                acc[i] += e * e;
+            }
+        }
+
+        float sum = 0.0f;
+        for (int i = 0; i < Block; ++i) sum += acc[i];
+        if (sum >= best) return sum;
+    }
+
+    float sum = 0.0f;
+    for (int i = 0; i < Block; ++i) sum += acc[i];
+    return sum;
+}
+
+float GestureMatcher::dtw(const float *query, int gesture, float best) const
+{
+    const float *t = &samples_[gesture * 3 * L];
+
+    float rows[2][L];
+    float *prev = rows[0], *curr = rows[1];
+    float cost[L];
+
+    for (int i = 0; i < L; ++i)
+    {
+        const int lo = std::max(0, i - Band), hi = std::min(L - 1, i + Band);
+
+        // Local costs of the band, vectorizable
+        const float qx = query[i], qy = query[L + i], qz = query[2 * L + i];
+        for (int j = lo; j <= hi; ++j)
+        {
+            float dx = qx - t[j], dy = qy - t[L + j], dz = qz - t[2 * L + j];
+            cost[j] = dx * dx + dy * dy + dz * dz;
+        }
+
+        // Accumulation, serial along the row
+        float rowMin = Infinity;
+        float left = Infinity;
+        for (int j = lo; j <= hi; ++j)
+        {
+            float up = (i > 0 && j <= i - 1 + Band)? prev[j] : Infinity; // prev only holds its own band
+            float diagonal = (i > 0 && j > 0)? prev[j - 1] : Infinity;
+            float m = (i == 0 && j == 0)? 0.0f : std::min(std::min(up, diagonal), left);
+
+            curr[j] = cost[j] + m;
+            left = curr[j];
+            rowMin = std::min(rowMin, curr[j]);
+        }
+
+        if (rowMin >= best) return Infinity; // every path through this row is already worse
+
+        std::swap(prev, curr);
+    }
+    return prev[L - 1];
+}
+
+bool GestureMatcher::makeQuery(History &history, float *query)
+{
+    const int now = (int)(window::getTime() * 1000.0);
+
+    points_.clear();
+    history.GetWorldPointsNewerThanTime(now - QueryWindowMs, points_);
+    if (points_.size() < 8) return false; // hand not tracked recently
+    std::reverse(points_.begin(), points_.end()); // oldest first
+
+    return normalize(&points_.data()->X, (int)points_.size(), query);
+}
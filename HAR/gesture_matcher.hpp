@@ -0,0 +1,91 @@
+#ifndef gesture_matcher_hpp
+#define gesture_matcher_hpp
+
+#include <string>
+#include <vector>
+
+#include "trajectory.hpp"
+
+// Gesture matcher
+//
+// Matches the recent trajectory of a hand against a library of template
+// gestures with Dynamic Time Warping. Templates and queries are resampled to
+// 'Length' points, centered and scaled to unit RMS radius, so a gesture
+// matches wherever and at whatever size it is made.
+//
+// Every template goes through a cascade, cheapest first, and stops as soon
+// as its lower bound exceeds the best distance so far:
+//  1. LB_Kim: first and last points, which every warping path aligns
+//  2. LB_Keogh: distance of the query to the template's precomputed band envelope
+//  3. DTW within a Sakoe-Chiba band, abandoned once a whole row exceeds the best
+// The best distance starts at the acceptance threshold, so most templates
+// never get past the first two steps.
+//
+// Templates are text files of "x y z" lines (world millimeters, oldest
+// first) in data/gestures; the file name is the gesture name.
+//
+class GestureMatcher
+{
+public:
+    static const int Length = 32;
+    static const int Band = 4;                  // Sakoe-Chiba radius, in samples
+    static const int QueryWindowMs = 1500;
+
+    struct Match
+    {
+        int gesture = -1;       // template index, -1 when nothing is close enough
+        float distance = 0.0f;  // RMS distance in units of the gesture radius
+    };
+
+    struct Stats
+    {
+        int candidates = 0;     // templates considered in the last update, both hands
+        int prunedKim = 0;
+        int prunedKeogh = 0;
+        int abandoned = 0;      // went through DTW without beating the best
+        double lastMs = 0.0;
+        double matchesPerSecond = 0.0;
+    };
+
+    float threshold = 0.35f;
+
+    /** Add every template of a directory. Returns the number added. */
+    int loadLibrary(const std::string &directory);
+
+    /** Add a template from 'count' xyz points, oldest first */
+    bool addGesture(const std::string &name, const float *xyz, int count);
+
+    /** Save the last 'QueryWindowMs' of 'history' as a template, and add it */
+    bool captureGesture(const std::string &directory, const std::string &name, History &history);
+
+    /** Match both hands, once per frame */
+    void update(History &leftHand, History &rightHand);
+
+    const Match &leftMatch() const { return matches_[0]; }
+    const Match &rightMatch() const { return matches_[1]; }
+
+    int gestureCount() const { return (int)names_.size(); }
+    const std::string &gestureName(int gesture) const { return names_[gesture]; }
+    const Stats &stats() const { return stats_; }
+
+    /** Matches per second over a synthetic library of 'templateCount' gestures */
+    static double benchmark(int templateCount, int queries);
+
+private:
+    Match match(const float *query);
+    float lowerBoundKeogh(const float *query, int gesture, float best) const;
+    float dtw(const float *query, int gesture, float best) const;
+
+    bool makeQuery(History &history, float *query);
+
+    // Template library, SoA: for gesture g, dimension d, sample i at [(g * 3 + d) * Length + i]
+    std::vector<float> samples_;
+    std::vector<float> upper_, lower_;  // Keogh envelopes, same layout
+    std::vector<std::string> names_;
+
+    Match matches_[2];
+    Stats stats_;
+    std::vector<XnPoint3D> points_;     // scratch for queries, kept to avoid per-frame allocations
+};
+
+#endif /* gesture_matcher_hpp */
@@ -1 +1,206 @@
 #include "graph_generators.hpp"
+
+#include <algorithm>
+
+
+// GraphGenerator
+//
+uint64_t GraphGenerator::newIdentity()
+{
+    static std::atomic<uint64_t> next(1);
+    return next.fetch_add(1, std::memory_order_relaxed) << 32;
+}
+
+
+// TimeSeriesGraphGenerator
+//
+TimeSeriesGraphGenerator::TimeSeriesGraphGenerator(unsigned int window, float minVal, float maxVal)
+: window_(std::max(window, 2u))
+, identity_(newIdentity())
+, claimed_(0)
+, written_(0)
+, snapshot_(window_, 0.0f)
+, minVal_(minVal)
+, maxVal_(maxVal)
+{
+    unsigned int capacity = 1;
+    while (capacity < 2 * window_) capacity <<= 1;
+    mask_ = capacity - 1;
+
+    ring_.reset(new std::atomic<float>[capacity]);
+    for (unsigned int i = 0; i < capacity; ++i) ring_[i].store(0.0f, std::memory_order_relaxed);
+}
+
+void TimeSeriesGraphGenerator::push(float value)
+{
+    // the claim is ordered before the store, so a reader that copied the new value also sees the claim
+    uint64_t index = written_.load(std::memory_order_relaxed);
+    claimed_.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring_[index & mask_].store(value, std::memory_order_relaxed);
+    written_.store(index + 1, std::memory_order_release);
+}
+
+unsigned int TimeSeriesGraphGenerator::numSamples()
+{
+    const uint64_t capacity = (uint64_t)mask_ + 1;
+    for (;;)
+    {
+        // Only what was pushed since the last snapshot; older samples are in it already
+        uint64_t end = written_.load(std::memory_order_acquire);
+        uint64_t first = std::max(snapshotEnd_, end > window_? end - window_ : 0);
+        for (uint64_t i = first; i < end; ++i)
+        {
+            snapshot_[i % window_] = ring_[i & mask_].load(std::memory_order_relaxed);
+        }
+
+        // Consistent unless the writer claimed slot 'first + capacity', the one holding 'first', while we copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (claimed_.load(std::memory_order_relaxed) - first <= capacity)
+        {
+            snapshotEnd_ = end;
+            break;
+        }
+    }
+    return window_;
+}
+
+
+// GraphDecimator
+//
+int GraphDecimator::decimate(GraphGenerator &graph, int first, int count, int columns)
+{
+    uint64_t revision = graph.revision();
+    if (revision != 0 && revision == revision_ && first == first_ && count == count_ && columns == columns_)
+    {
+        return points_;
+    }
+    revision_ = revision;
+    first_ = first;
+    count_ = count;
+    columns_ = columns;
+
+    uint64_t end = graph.streamEnd();
+    if (end != 0 && first == 0 && count == (int)graph.numSamples())
+    {
+        decimateStream(graph, end, count, columns);
+        return points_;
+    }
+    buckets_.clear();
+    streamEnd_ = 0;
+
+    samples_.resize(count);
+    graph.fillSamples(samples_.data(), first, count);
+
+    index_.clear();
+    value_.clear();
+    if (count <= 2 * columns)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            index_.push_back((float)(first + i));
+            value_.push_back(samples_[i]);
+        }
+    }
+    else
+    {
+        for (int c = 0; c < columns; ++c)
+        {
+            int begin = (int)((int64_t)c * count / columns), end = (int)((int64_t)(c + 1) * count / columns);
+            int lo = begin, hi = begin;
+            for (int i = begin + 1; i < end; ++i)
+            {
+                if (samples_[i] < samples_[lo]) lo = i;
+                if (samples_[i] > samples_[hi]) hi = i;
+            }
+
+            int a = std::min(lo, hi), b = std::max(lo, hi);
+            index_.push_back((float)(first + a));
+            value_.push_back(samples_[a]);
+            if (b != a)
+            {
+                index_.push_back((float)(first + b));
+                value_.push_back(samples_[b]);
+            }
+        }
+    }
+
+    points_ = (int)index_.size();
+    return points_;
+}
+
+void GraphDecimator::decimateStream(GraphGenerator &graph, uint64_t end, int count, int columns)
+{
+    // Sample number 's' is at window position s + count - end
+    const int64_t offset = (int64_t)count - (int64_t)end;
+    const uint64_t windowBegin = end > (uint64_t)count? end - count : 0;
+    const int bucketSize = (count + columns - 1) / columns;
+
+    // Start over when the columns changed, the graph went back, or everything shown is new
+    uint64_t from = streamEnd_;
+    if (bucketSize != bucketSize_ || end < streamEnd_ || end - streamEnd_ >= (uint64_t)count)
+    {
+        buckets_.clear();
+        bucketSize_ = bucketSize;
+        from = windowBegin;
+    }
+
+    samples_.resize(end - from);
+    graph.fillSamples(samples_.data(), (int)(from + offset), (int)(end - from));
+    for (uint64_t s = from; s < end; ++s) fold(s, samples_[s - from]);
+    streamEnd_ = end;
+
+    // Slide: buckets left of the window go, the one across its left edge loses the samples that left
+    while (!buckets_.empty() && buckets_.front().first + bucketSize <= windowBegin) buckets_.pop_front();
+    if (!buckets_.empty() && (buckets_.front().lo < windowBegin || buckets_.front().hi < windowBegin))
+    {
+        Bucket &b = buckets_.front();
+        const uint64_t bucketEnd = std::min(b.first + bucketSize, end);
+        samples_.resize(bucketEnd - windowBegin);
+        graph.fillSamples(samples_.data(), (int)(windowBegin + offset), (int)(bucketEnd - windowBegin));
+
+        b.lo = b.hi = windowBegin;
+        b.loValue = b.hiValue = samples_[0];
+        for (uint64_t s = windowBegin + 1; s < bucketEnd; ++s)
+        {
+            float v = samples_[s - windowBegin];
+            if (v < b.loValue) { b.lo = s; b.loValue = v; }
+            if (v > b.hiValue) { b.hi = s; b.hiValue = v; }
+        }
+    }
+
+    // Points, in sample order; until the window fills up, the oldest sample pads it on the left
+    index_.clear();
+    value_.clear();
+    if (offset > 0 && !buckets_.empty())
+    {
+        index_.push_back(0.0f);
+        value_.push_back(graph.valueAt(0));
+    }
+    for (const Bucket &b : buckets_)
+    {
+        uint64_t a = std::min(b.lo, b.hi), c = std::max(b.lo, b.hi);
+        index_.push_back((float)((int64_t)a + offset));
+        value_.push_back(a == b.lo? b.loValue : b.hiValue);
+        if (c != a)
+        {
+            index_.push_back((float)((int64_t)c + offset));
+            value_.push_back(c == b.lo? b.loValue : b.hiValue);
+        }
+    }
+    points_ = (int)index_.size();
+}
+
+void GraphDecimator::fold(uint64_t sample, float value)
+{
+    const uint64_t first = sample - sample % bucketSize_;
+    if (buckets_.empty() || buckets_.back().first != first)
+    {
+        buckets_.push_back({ first, sample, sample, value, value });
+        return;
+    }
+
+    Bucket &b = buckets_.back();
+    if (value < b.loValue) { b.lo = sample; b.loValue = value; }
+    if (value > b.hiValue) { b.hi = sample; b.hiValue = value; }
+}
@@ -1,8 +1,14 @@
 #ifndef graph_generators_hpp
 #define graph_generators_hpp
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
+#include <memory>
+#include <vector>
 
 struct GraphGenerator
 {
@@ -10,6 +16,25 @@ struct GraphGenerator
     virtual float minValue() = 0;
     virtual float maxValue() = 0;
     virtual float valueAt(int sample) = 0;
+
+    /** Values of samples [first, first + count) into 'values'. Override when a batch is cheaper than valueAt() per sample. */
+    virtual void fillSamples(float *values, int first, int count)
+    {
+        for (int i = 0; i < count; ++i) values[i] = valueAt(first + i);
+    }
+
+    /** Changes whenever the samples do, unique across generators; 0 if unknown, which disables caching */
+    virtual uint64_t revision() { return 0; }
+
+    /**
+     * For graphs that only append: samples appended so far, of which the last numSamples() are
+     * shown. Lets a decimator fold in only the new samples. 0 for other graphs.
+     */
+    virtual uint64_t streamEnd() { return 0; }
+
+protected:
+    /** Unique base for revision(), in the high 32 bits */
+    static uint64_t newIdentity();
 };
 
 
@@ -23,6 +48,7 @@ struct SinWaveGenerator : public GraphGenerator
     , numSamples_((float)(numcycles * resolution))
     , minVal_(minVal)
     , maxVal_(maxVal)
+    , identity_(newIdentity())
     {
     }
 
@@ -33,17 +59,28 @@ struct SinWaveGenerator : public GraphGenerator
     {
         return minValue() + (maxValue() - minValue()) * 0.5f * (::sin(numCycles_ * TwoPi * sample / numSamples_) + 1.0f);
     }
+    void fillSamples(float *values, int first, int count) override
+    {
+        const float scale = 0.5f * (maxVal_ - minVal_), step = numCycles_ * TwoPi / numSamples_;
+        for (int i = 0; i < count; ++i)
+        {
+            values[i] = minVal_ + scale * (::sinf(step * (first + i)) + 1.0f);
+        }
+    }
+    uint64_t revision() override { return identity_; }
     
 private:
     int numCycles_, resolution_;
     float numSamples_;
     float minVal_, maxVal_;
+    uint64_t identity_;
 };
 
 struct TriangleWaveGenerator : public GraphGenerator
 {
     TriangleWaveGenerator(int numSamples)
     : numSamples_(numSamples)
+    , identity_(newIdentity())
     {}
     
     unsigned int numSamples() override { return numSamples_; }
@@ -53,9 +90,16 @@ struct TriangleWaveGenerator : public GraphGenerator
     {
         return ((sample % 2) == 0)? minValue() : maxValue();
     }
+    void fillSamples(float *values, int first, int count) override
+    {
+        const float lo = minValue(), hi = maxValue();
+        for (int i = 0; i < count; ++i) values[i] = (((first + i) % 2) == 0)? lo : hi;
+    }
+    uint64_t revision() override { return identity_; }
     
 private:
     int numSamples_;
+    uint64_t identity_;
 
 };
 
@@ -78,4 +122,124 @@ private:
     int numSamples_;
 };
 
+// Values of an array owned elsewhere, read as they are when plotted
+//
+struct ArrayGraphGenerator : public GraphGenerator
+{
+    ArrayGraphGenerator(const float *values, int count, float minVal, float maxVal)
+    : values_(values)
+    , count_(count)
+    , minVal_(minVal)
+    , maxVal_(maxVal)
+    {
+    }
+
+    unsigned int numSamples() override { return count_; }
+    float minValue() override { return minVal_; }
+    float maxValue() override { return maxVal_; }
+    float valueAt(int sample) override { return values_[sample]; }
+    void fillSamples(float *values, int first, int count) override
+    {
+        std::copy(values_ + first, values_ + first + count, values);
+    }
+
+private:
+    const float *values_;
+    int count_;
+    float minVal_, maxVal_;
+};
+
+
+// Time series
+//
+// Last 'window' samples of a live value, newest on the right. One thread
+// pushes, another plots, without locks, as a seqlock: the writer claims the
+// slot, stores the sample, then publishes the new count; the reader copies the
+// samples published since its last snapshot on numSamples() and retries if a
+// claim reached the copied range meanwhile. The ring holds twice the window
+// so a retry is rare even when the reader is descheduled.
+//
+struct TimeSeriesGraphGenerator : public GraphGenerator
+{
+    TimeSeriesGraphGenerator(unsigned int window, float minVal, float maxVal);
+
+    /** Append a sample. Wait-free, from one writer thread only. */
+    void push(float value);
+
+    /** Samples pushed so far */
+    uint64_t count() const { return written_.load(std::memory_order_acquire); }
+
+    /** Updates the snapshot that valueAt() reads: call first, from the reader thread */
+    unsigned int numSamples() override;
+    float minValue() override { return minVal_; }
+    float maxValue() override { return maxVal_; }
+    float valueAt(int sample) override { return snapshotEnd_ > 0? snapshot_[slot(sample)] : 0.0f; }
+    void fillSamples(float *values, int first, int count) override
+    {
+        for (int i = 0; i < count; ++i) values[i] = valueAt(first + i);
+    }
+    uint64_t revision() override { return identity_ | (snapshotEnd_ & 0xffffffffu); }
+    uint64_t streamEnd() override { return snapshotEnd_; }
+
+private:
+    /** Snapshot slot of a window sample; left of the oldest sample pushed, the oldest one */
+    unsigned int slot(int sample) const
+    {
+        int64_t pushed = (int64_t)snapshotEnd_ - window_ + sample;
+        return (unsigned int)(std::max<int64_t>(pushed, 0) % window_);
+    }
+
+    unsigned int window_, mask_;
+    uint64_t identity_;
+    uint64_t snapshotEnd_ = 0;      // samples pushed when the snapshot was taken
+    std::unique_ptr<std::atomic<float>[]> ring_;
+    std::atomic<uint64_t> claimed_;     // slots the writer has started to store
+    std::atomic<uint64_t> written_;     // slots stored
+    std::vector<float> snapshot_;   // reader side only, a ring by sample number
+    float minVal_, maxVal_;
+};
+
+// Graph decimation
+//
+// Reduces a range of samples to at most two points per pixel column: the
+// minimum and the maximum of each column, in sample order, so spikes survive
+// however long the range. The result is cached, and reused as long as the
+// graph revision, the range and the column count stay the same, so plotting
+// costs the same for a few seconds or for minutes of history.
+//
+// Streams (see GraphGenerator::streamEnd()) change every frame, so for them
+// the columns are buckets over sample numbers instead: new samples are folded
+// into the newest bucket, and buckets fall off the left as the window slides.
+// An update costs the new samples plus one bucket, not the whole window.
+//
+struct GraphDecimator
+{
+    /** Decimate samples [first, first + count). Returns the number of points. */
+    int decimate(GraphGenerator &graph, int first, int count, int columns);
+
+    /** Points of the last decimate(): sample index and value */
+    const float *index() const { return index_.data(); }
+    const float *value() const { return value_.data(); }
+
+private:
+    struct Bucket
+    {
+        uint64_t first;             // sample number, a multiple of the bucket size
+        uint64_t lo, hi;            // sample numbers of the minimum and the maximum
+        float loValue, hiValue;
+    };
+
+    void decimateStream(GraphGenerator &graph, uint64_t end, int count, int columns);
+    void fold(uint64_t sample, float value);
+
+    uint64_t revision_ = 0;
+    int first_ = 0, count_ = 0, columns_ = 0, points_ = 0;
+    std::vector<float> samples_;
+    std::vector<float> index_, value_;
+
+    std::deque<Bucket> buckets_;    // streams: oldest first
+    uint64_t streamEnd_ = 0;        // samples folded in
+    int bucketSize_ = 0;
+};
+
 #endif /* graph_generators_hpp */
@@ -23,10 +23,16 @@ namespace
             ImGui::PopStyleColor();
         }
     }
+    
+    // The overlay layers hold premultiplied color
+    void blendPremultiplied(const ImDrawList *, const ImDrawCmd *) { glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); }
+    void blendStraight(const ImDrawList *, const ImDrawCmd *) { glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); }
 }
 
 void GUIHelper::drawCurrentScreen(gfx::DynamicTextureGenerator &depthViz, gfx::DynamicTextureGenerator &rgbFeed)
 {
+    auto start = std::chrono::steady_clock::now();
+    
     switch (currentScreen)
     {
     case Screen::Startup:
@@ -45,6 +51,9 @@ void GUIHelper::drawCurrentScreen(gfx::DynamicTextureGenerator &depthViz, gfx::D
         }
         break;
     };
+    
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    frameMs = frameMs * 0.95 + elapsed * 0.05;
 }
 
 void GUIHelper::init()
@@ -124,6 +133,7 @@ void GUIHelper::doMainContent(gfx::DynamicTextureGenerator &depthTexgen, gfx::Dy
         ImGui::Begin("main-content", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoInputs);
         {
             ImTextureID tex = 0;
+            gfx::Texture *overlay = nullptr;
             ImVec2 uv1, uv2;
             
             switch(currentMainPanelTab)
@@ -131,6 +141,7 @@ void GUIHelper::doMainContent(gfx::DynamicTextureGenerator &depthTexgen, gfx::Dy
             case MainPanelTab::RGB:
                 {
                     tex = reinterpret_cast<void *>(rgbTexgen.getTexture()->platformHandle());
+                    overlay = rgbTexgen.getOverlay();
                     uv1 = rgbTexgen.getUV1();
                     uv2 = rgbTexgen.getUV2();
                 }
@@ -139,6 +150,7 @@ void GUIHelper::doMainContent(gfx::DynamicTextureGenerator &depthTexgen, gfx::Dy
             case MainPanelTab::DEPTH:
                 {
                     tex = reinterpret_cast<void *>(depthTexgen.getTexture()->platformHandle());
+                    overlay = depthTexgen.getOverlay();
                     uv1 = depthTexgen.getUV1();
                     uv2 = depthTexgen.getUV2();
                 }
@@ -150,6 +162,15 @@ void GUIHelper::doMainContent(gfx::DynamicTextureGenerator &depthTexgen, gfx::Dy
             auto iw = maxSize.x - minSize.x;
             auto ih = maxSize.y - minSize.y;
             ImGui::Image(tex, ImVec2(iw, ih), uv1, uv2);
+            
+            // skeletons and labels, composited over the image on the GPU
+            if (overlay)
+            {
+                auto *drawList = ImGui::GetWindowDrawList();
+                drawList->AddCallback(blendPremultiplied, nullptr);
+                drawList->AddImage(reinterpret_cast<void *>(overlay->platformHandle()), ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), uv1, uv2);
+                drawList->AddCallback(blendStraight, nullptr);
+            }
         }
         ImGui::End();
     }
@@ -164,6 +185,163 @@ void GUIHelper::doLeftPanel()
         ImGui::LabelText("Prop1", "%0.3f", someproperty0);
         ImGui::LabelText("Prop2", "%0.3f", someproperty1);
         ImGui::LabelText("Prop3", "%0.3f", someproperty2);
+        
+        int profile = g_SkeletonProfile;
+        if (ImGui::Combo("Skeleton", &profile, "Full body\0Upper body\0")) g_SkeletonProfile = (skeleton::Profile)profile;
+        
+        bool bTextBenchmark = g_bTextBenchmark;
+        if (ImGui::Checkbox("Text benchmark", &bTextBenchmark)) g_bTextBenchmark = bTextBenchmark;
+        auto &text = gfx::textStats();
+        ImGui::LabelText("Labels", "%d (%d chars)", text.strings, text.characters);
+        ImGui::LabelText("Text", "%0.3f ms, %d draw", text.averageMs, text.drawCalls);
+        if (ogl)
+        {
+            auto &overlay = ogl->skeletonRenderer();
+            ImGui::LabelText("Overlay", "%d verts, %d inst", overlay.lastVertexCount(), overlay.lastInstanceCount());
+            ImGui::LabelText("Overlay GPU", "%0.3f ms", overlay.gpuMs());
+        }
+        
+        if (gaps)
+        {
+            ImGui::Separator();
+            ImGui::SliderFloat("Extrapolate", &gaps->settings.maxExtrapolation, 0.0f, 1.0f, "%0.2f s");
+            ImGui::LabelText("Filled joints", "%d", gaps->filledJoints());
+            ImGui::LabelText("Gaps", "%0.3f ms", gaps->averageUpdateMs());
+        }
+        if (jointFilters)
+        {
+            ImGui::Separator();
+            auto &settings = jointFilters->settings;
+            int mode = settings.mode;
+            if (ImGui::Combo("Filter", &mode, "One-Euro\0Kalman\0")) settings.mode = (JointFilterBank::Mode)mode;
+            if (settings.mode == JointFilterBank::OneEuro)
+            {
+                ImGui::SliderFloat("Min cutoff", &settings.minCutoff, 0.05f, 10.0f, "%0.2f Hz", 2.0f);
+                ImGui::SliderFloat("Beta", &settings.beta, 0.0f, 0.05f, "%0.4f", 2.0f);
+            }
+            else
+            {
+                ImGui::SliderFloat("Accel noise", &settings.accelerationNoise, 100.0f, 20000.0f, "%0.0f mm/s2", 2.0f);
+                ImGui::SliderFloat("Meas noise", &settings.measurementNoise, 1.0f, 100.0f, "%0.1f mm");
+            }
+            ImGui::LabelText("Filters", "%0.3f ms", jointFilters->averageUpdateMs());
+        }
+        if (features)
+        {
+            ImGui::Separator();
+            ImGui::LabelText("Features", "%0.3f ms", features->averageUpdateMs());
+        }
+        if (classifier)
+        {
+            auto &timing = classifier->timing();
+            ImGui::LabelText("Classifier", "%0.3f ms", timing.averageMs);
+            ImGui::LabelText("Worst", "%0.3f ms", timing.worstMs);
+            ImGui::LabelText("Users", "%d", timing.users);
+            
+            if (ImGui::Button("Classifier benchmark"))
+            {
+                classifierBenchmark = ActivityClassifier::benchmark(ActivityClassifier::MaxUsers, 1000);
+            }
+            if (classifierBenchmark.users > 0)
+            {
+                ImGui::LabelText("6 users", "%0.3f ms", classifierBenchmark.averageMs);
+                ImGui::LabelText("6 users worst", "%0.3f ms", classifierBenchmark.worstMs);
+            }
+        }
+        if (activityStates)
+        {
+            ImGui::LabelText("Decoder", "%0.3f ms", activityStates->averageUpdateMs());
+        }
+        
+        if (predictor)
+        {
+            ImGui::Separator();
+            ImGui::SliderFloat("Horizon", &predictor->settings.horizon, 0.25f, 3.0f, "%0.2f s");
+            for (int hand = 0; hand < 2; ++hand)
+            {
+                int target = predictor->likelyTarget(hand);
+                const char *label = hand == 0? "Left contact" : "Right contact";
+                if (target >= 0)
+                {
+                    ImGui::LabelText(label, "%0.2f s (%d)", predictor->prediction(hand, target).timeToContact, target);
+                }
+                else
+                {
+                    ImGui::LabelText(label, "-");
+                }
+            }
+            ImGui::LabelText("Predictor", "%0.3f ms", predictor->averageUpdateMs());
+        }
+        if (forecaster)
+        {
+            ImGui::SliderFloat("Cone budget", &forecaster->settings.budgetMs, 0.25f, 8.0f, "%0.2f ms");
+            ImGui::LabelText("Particles", "%d (%d threads)", forecaster->particles(), forecaster->threads());
+            ImGui::LabelText("Forecast", "%0.3f ms", forecaster->lastMs());
+        }
+        
+        if (gestures)
+        {
+            ImGui::Separator();
+            auto gestureName = [this](const GestureMatcher::Match &match) {
+                return match.gesture >= 0? gestures->gestureName(match.gesture).c_str() : "-";
+            };
+            auto &stats = gestures->stats();
+            ImGui::LabelText("Gestures", "%d", gestures->gestureCount());
+            ImGui::LabelText("Left hand", "%s", gestureName(gestures->leftMatch()));
+            ImGui::LabelText("Right hand", "%s", gestureName(gestures->rightMatch()));
+            ImGui::LabelText("Matching", "%0.3f ms", stats.lastMs);
+            ImGui::LabelText("Rate", "%0.1f M/s", stats.matchesPerSecond * 1e-6);
+            
+            if (ImGui::Button("Capture right hand"))
+            {
+                gestures->captureGesture("data/gestures", "gesture-" + std::to_string(gestures->gestureCount()), g_RightHandPositionHistory);
+            }
+            if (ImGui::Button("Benchmark"))
+            {
+                for (int k = 0; k < 4; ++k)
+                {
+                    gestureBenchmark[k] = GestureMatcher::benchmark(100 << k, 200);
+                }
+            }
+            for (int k = 0; k < 4; ++k)
+            {
+                if (gestureBenchmark[k] > 0.0)
+                {
+                    ImGui::LabelText(std::to_string(100 << k).c_str(), "%0.1f M/s", gestureBenchmark[k] * 1e-6);
+                }
+            }
+        }
+        
+        ImGui::Separator();
+        ImGui::LabelText("GUI frame", "%0.3f ms", frameMs);
+        if (ImGui::Button("Plot benchmark"))
+        {
+            benchmarkGraphs();
+        }
+        if (graphBenchmark[0] > 0.0)
+        {
+            ImGui::LabelText("10k per line", "%0.3f ms", graphBenchmark[0]);
+            ImGui::LabelText("10k decimated", "%0.3f ms", graphBenchmark[1]);
+            ImGui::LabelText("10k cached", "%0.3f ms", graphBenchmark[2]);
+        }
+        
+        ImGui::Separator();
+        auto &recording = session::policy();
+        ImGui::LabelText("Recording", "%s", recording.isRecording()? "active" : "idle");
+        ImGui::LabelText("Pre-roll", "%0.1f MB", recording.stats().bytesBuffered / (1024.0f * 1024.0f));
+        auto &segments = session::output().stats();
+        ImGui::LabelText("Written", "%0.1f MB", segments.bytesWritten / (1024.0f * 1024.0f));
+        ImGui::LabelText("On disk", "%0.2f / %0.0f GB", segments.bytesOnDisk / (1024.0 * 1024.0 * 1024.0),
+                         session::output().settings().diskBudgetBytes / (1024.0 * 1024.0 * 1024.0));
+        ImGui::LabelText("Segment", "%u (%llu rotated, %llu evicted)", segments.segment,
+                         (unsigned long long)segments.rotations, (unsigned long long)segments.evictions);
+        auto io = session::output().ioStats();
+        ImGui::LabelText("Disk", "%0.1f MB/s (%s)", io.throughput / (1024.0 * 1024.0), session::output().ioBackend());
+        if (io.stalls > 0)
+        {
+            ImGui::LabelText("Disk stalls", "%llu", (unsigned long long)io.stalls);
+        }
+        ImGui::Checkbox("Crop to users", &bRoiRecording);
     }
     ImGui::End();
 }
@@ -204,12 +382,6 @@ void GUIHelper::doRightPanel()
 
 void GUIHelper::doBottomPanel()
 {
-    static TestBarGraphGenerator graph;
-    graph.update();
-    
-    static TestStatesInfo states;
-    states.update();
-    
     ImGui::SetNextWindowPos(ImVec2(0, windowSize.y - 200));
     ImGui::SetNextWindowSize(ImVec2(windowSize.x, 200));
     ImGui::Begin("Plots", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse);
@@ -232,22 +404,25 @@ void GUIHelper::doBottomPanel()
         auto bargraphMinPt = pos;
         auto bargraphMaxPt = ImVec2(pos.x + plotWidth, pos.y + h);
         dl->AddRectFilled(bargraphMinPt, bargraphMaxPt, 0x66000000, 10.0f);
-        drawBarGraph(dl, bargraphMinPt, bargraphMaxPt, graph);
+        if (classifier)
+        {
+            classifier->update();
+            drawBarGraph(dl, bargraphMinPt, bargraphMaxPt, *classifier);
+        }
         
         auto statesMinPt = ImVec2(pos.x + wby2, pos.y);
         auto statesMaxPt = ImVec2(pos.x + wby2 + plotWidth, pos.y + h);
         dl->AddRectFilled(statesMinPt, statesMaxPt, 0x66000000, 10.0f);
-        drawStates(dl, dc, statesMinPt, statesMaxPt, states);
+        if (activityStates)
+        {
+            drawStates(dl, dc, statesMinPt, statesMaxPt, *activityStates);
+        }
     }
     ImGui::End();
 }
 
 void GUIHelper::drawHandTrajectories()
 {
-    static SinWaveGenerator sinWave(3, 20, -1.0f, 1.0f);
-    static TriangleWaveGenerator triangleWave(3);
-    static RandomWaveGenerator randomWave(3);
-    
     using namespace ImGui;
     ImGuiWindow* wind = GetCurrentWindow();
     ImDrawList* dl = wind->DrawList;
@@ -265,25 +440,26 @@ void GUIHelper::drawHandTrajectories()
     auto graphMinPt = pos;
     auto graphMaxPt = ImVec2(pos.x + w, pos.y + graphHeight);
     dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
+    if (liveGraphs)
     {
-        drawGraph(dl, graphMinPt, graphMaxPt, triangleWave, 0xffffffff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->handSpeed[0], 0xff00ff00);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->handSpeed[1], 0xff0000ff);
     }
+    dl->AddText(graphMinPt, 0xffffffff, "Hand speed");
     
     graphMinPt = ImVec2(pos.x, pos.y + hby2);
     graphMaxPt = ImVec2(pos.x + w, pos.y + hby2 + graphHeight);
     dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
+    if (liveGraphs)
     {
-        drawGraph(dl, graphMinPt, graphMaxPt, sinWave, 0xffffffff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->handToTarget[0], 0xff00ff00);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->handToTarget[1], 0xff0000ff);
     }
+    dl->AddText(graphMinPt, 0xffffffff, "Distance to target");
 }
 
 void GUIHelper::drawPredictedTrajectories()
 {
-    static SinWaveGenerator sinWave(3, 20, -1.0f, 1.0f);
-    static TriangleWaveGenerator triangleWave(15);
-    static SinWaveGenerator sinWave2(4, 25, -1.0f, 1.0f);
-    static TriangleWaveGenerator triangleWave2(22);
-
     using namespace ImGui;
     ImGuiWindow* wind = GetCurrentWindow();
     ImDrawList* dl = wind->DrawList;
@@ -298,13 +474,26 @@ void GUIHelper::drawPredictedTrajectories()
     auto hby2 = h / 2;
     auto graphHeight = hby2 - 2;
     
+    const ImU32 handColors[2] = { 0xff00ff00, 0xff0000ff };
+    
     auto graphMinPt = pos;
     auto graphMaxPt = ImVec2(pos.x + w, pos.y + graphHeight);
     dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
+    if (liveGraphs)
     {
-        drawGraph(dl, graphMinPt, graphMaxPt, sinWave, 0xff0000ff);
-        drawGraph(dl, graphMinPt, graphMaxPt, triangleWave, 0xff00ff00);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->timeToContact[0], handColors[0]);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->timeToContact[1], handColors[1]);
     }
+    dl->AddText(graphMinPt, 0xffffffff, "Time to contact");
+    
+    if (!predictor) return;
+    
+    // Forecast distance to the targets over the horizon, now on the left
+    auto drawForecast = [&](ImVec2 minPt, ImVec2 maxPt, int hand, int target, ImU32 col) {
+        if (!predictor->isTracking(hand) || target >= predictor->targetCount()) return;
+        ArrayGraphGenerator distance(predictor->prediction(hand, target).distance, TrajectoryPredictor::Steps + 1, 0.0f, 1500.0f);
+        drawGraph(dl, minPt, maxPt, distance, col);
+    };
     
     if (currentScreen == Screen::SingleTarget)
     {
@@ -312,36 +501,31 @@ void GUIHelper::drawPredictedTrajectories()
         graphMaxPt = ImVec2(pos.x + w, pos.y + hby2 + graphHeight);
         dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
         {
-            drawGraph(dl, graphMinPt, graphMaxPt, triangleWave2, 0xff0000ff);
-            drawGraph(dl, graphMinPt, graphMaxPt, sinWave2, 0xff00ff00);
+            drawForecast(graphMinPt, graphMaxPt, 0, 0, handColors[0]);
+            drawForecast(graphMinPt, graphMaxPt, 1, 0, handColors[1]);
         }
+        dl->AddText(graphMinPt, 0xffffffff, "Forecast distance to head");
     }
     else if (currentScreen == Screen::MultiTarget)
     {
-        graphMinPt = ImVec2(pos.x, pos.y + hby2);
-        graphMaxPt = ImVec2(pos.x + w / 2, pos.y + hby2 + graphHeight);
-        dl->AddRectFilled(graphMinPt, graphMaxPt, 0x440000ff, 10.0f);
+        const ImU32 targetColors[TrajectoryPredictor::MaxTargets] = { 0xff00ffff, 0xffff0000, 0xffff00ff, 0xffffffff };
+        const char *labels[2] = { "Left hand", "Right hand" };
+        for (int hand = 0; hand < 2; ++hand)
         {
-            drawGraph(dl, graphMinPt, graphMaxPt, triangleWave2, 0xff00ffff);
-            drawGraph(dl, graphMinPt, graphMaxPt, sinWave2, 0xffff0000);
-        }
-        dl->AddText(graphMinPt, 0xffffffff, "X");
-
-        graphMinPt = ImVec2(pos.x + w / 2, pos.y + hby2);
-        graphMaxPt = ImVec2(pos.x + w, pos.y + hby2 + graphHeight);
-        dl->AddRectFilled(graphMinPt, graphMaxPt, 0x4400ff00, 10.0f);
-        {
-            drawGraph(dl, graphMinPt, graphMaxPt, triangleWave2, 0xff00ffff);
-            drawGraph(dl, graphMinPt, graphMaxPt, sinWave2, 0xffff0000);
+            graphMinPt = ImVec2(pos.x + hand * w / 2, pos.y + hby2);
+            graphMaxPt = ImVec2(pos.x + (hand + 1) * w / 2, pos.y + hby2 + graphHeight);
+            dl->AddRectFilled(graphMinPt, graphMaxPt, hand == 0? 0x4400ff00 : 0x440000ff, 10.0f);
+            for (int target = 0; target < predictor->targetCount(); ++target)
+            {
+                drawForecast(graphMinPt, graphMaxPt, hand, target, targetColors[target]);
+            }
+            dl->AddText(graphMinPt, 0xffffffff, labels[hand]);
         }
-        dl->AddText(graphMinPt, 0xffffffff, "Y");
     }
 }
 
 void GUIHelper::drawDistanceGraph()
 {
-    static RandomWaveGenerator randomWave(30);
-    
     using namespace ImGui;
     ImGuiWindow* wind = GetCurrentWindow();
     ImDrawList* dl = wind->DrawList;
@@ -357,15 +541,17 @@ void GUIHelper::drawDistanceGraph()
     auto graphMinPt = pos;
     auto graphMaxPt = ImVec2(pos.x + w, pos.y + h);
     dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
+    if (liveGraphs)
     {
-        drawGraph(dl, graphMinPt, graphMaxPt, randomWave, 0xffffffff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->headToHand[0], 0xff00ff00);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->headToHand[1], 0xff0000ff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->handToHand, 0xffffffff);
     }
+    dl->AddText(graphMinPt, 0xffffffff, "Head to hands, hand to hand");
 }
 
 void GUIHelper::drawAngleGraph()
 {
-    static SinWaveGenerator sinWave(3, 20, 0.0f, 1.0f);
-    
     using namespace ImGui;
     ImGuiWindow* wind = GetCurrentWindow();
     ImDrawList* dl = wind->DrawList;
@@ -381,9 +567,14 @@ void GUIHelper::drawAngleGraph()
     auto graphMinPt = pos;
     auto graphMaxPt = ImVec2(pos.x + w, pos.y + h);
     dl->AddRectFilled(graphMinPt, graphMaxPt, 0x66000000, 10.0f);
+    if (liveGraphs)
     {
-        drawGraph(dl, graphMinPt, graphMaxPt, sinWave, 0xffffffff, -1.0f, 1.0f);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->elbowAngle[0], 0xff00ff00);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->elbowAngle[1], 0xff0000ff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->kneeAngle[0], 0xff00ffff);
+        drawGraph(dl, graphMinPt, graphMaxPt, liveGraphs->kneeAngle[1], 0xffff00ff);
     }
+    dl->AddText(graphMinPt, 0xffffffff, "Elbows, knees");
 }
 
 void GUIHelper::drawBarGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, BarGraphGenerator &graph)
@@ -394,7 +585,7 @@ void GUIHelper::drawBarGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, BarGrap
 
     float maxBarHeight = maxPt.y - minPt.y;
     
-    ImGui::BeginColumns("col", 6);
+    ImGui::BeginColumns("col", N);
     for (int k = 0; k < N; ++k)
     {
         float value = graph.valueAtBar(k) * 0.01f;
@@ -404,7 +595,7 @@ void GUIHelper::drawBarGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, BarGrap
         
         dl->AddRectFilled(bl, tr, 0xff0000ff);
         
-        ImGui::SetColumnWidth(k, barWidth); ImGui::Text("Action"); ImGui::NextColumn(); //text need to change
+        ImGui::SetColumnWidth(k, barWidth); ImGui::Text("%s", graph.barLabel(k)); ImGui::NextColumn();
     }
     ImGui::EndColumns();
 }
@@ -447,7 +638,7 @@ void GUIHelper::drawStates(ImDrawList* dl, ImGuiDrawContext& dc, ImVec2 minPt, I
                 }
                 
                 ImGui::SetCursorScreenPos(colStart);
-                ImGui::Text("State"); // text need to change
+                ImGui::Text("%s", states.stateName(currentState));
                 
                 ++currentState;
                 if (currentState == numStates) break;
@@ -470,32 +661,67 @@ void GUIHelper::drawGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, GraphGener
     
     dl->AddLine(startPt, endPt, 0x66ffffff, 1.0f);
     
-    auto steps = graph.numSamples();
+    int steps = graph.numSamples();
     assert(steps > 1 && "Steps shoud be greater than 1!");
-    float deltaX = (maxPt.x - minPt.x) / (steps - 1);
     
-    auto evaluatePt = [&](int sample)
-    {
-        float minY = maxPt.y;
-        float maxY = minPt.y;
-        
-        float x = startPt.x + sample * deltaX;
-        float y = (graph.valueAt(sample) - minValue) / (maxValue - minValue);
-        y = y * maxY + (1.0f - y) * minY;
-        
-        return ImVec2(x, y);
-    };
-    
-    ImVec2 prevPt = evaluatePt(0);
+    // At most two points per pixel column, cached per graph, then one polyline
+    if (decimators.size() > 64) decimators.clear(); // graphs that came and went
+    GraphDecimator &decimator = decimators[&graph];
+    int count = decimator.decimate(graph, 0, steps, std::max(1, (int)(maxPt.x - minPt.x)));
     
-    for (auto i = 1; i < steps; ++i)
+    graphPoints.resize(count);
+    const float deltaX = (maxPt.x - minPt.x) / (steps - 1);
+    const float scaleY = (minPt.y - maxPt.y) / (maxValue - minValue);
+    for (int i = 0; i < count; ++i)
     {
-        ImVec2 currPt = evaluatePt(i);
-        
-        dl->AddLine(prevPt, currPt, col, 1.0f);
-        
-        prevPt = currPt;
+        graphPoints[i] = ImVec2(startPt.x + decimator.index()[i] * deltaX, maxPt.y + (decimator.value()[i] - minValue) * scaleY);
     }
+    
+    dl->AddPolyline(graphPoints.Data, count, col, false, 1.0f, true);
+}
+
+void GUIHelper::benchmarkGraphs()
+{
+    const int Iterations = 20;
+    SinWaveGenerator wave(50, 200, -1.0f, 1.0f); // 10k samples
+    ImVec2 minPt(0, 0), maxPt(400, 200);
+    
+    ImDrawList scratch;
+    auto time = [&](auto plot) {
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < Iterations; ++k)
+        {
+            scratch.Clear();
+            scratch.AddDrawCmd();
+            plot();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / Iterations;
+    };
+    
+    // The previous path, for comparison: one virtual call and one line per segment
+    graphBenchmark[0] = time([&] {
+        int steps = wave.numSamples();
+        float deltaX = (maxPt.x - minPt.x) / (steps - 1);
+        auto evaluatePt = [&](int sample) {
+            float y = (wave.valueAt(sample) - wave.minValue()) / (wave.maxValue() - wave.minValue());
+            return ImVec2(minPt.x + sample * deltaX, y * minPt.y + (1.0f - y) * maxPt.y);
+        };
+        ImVec2 prevPt = evaluatePt(0);
+        for (int i = 1; i < steps; ++i)
+        {
+            ImVec2 currPt = evaluatePt(i);
+            scratch.AddLine(prevPt, currPt, 0xffffffff, 1.0f);
+            prevPt = currPt;
+        }
+    });
+    graphBenchmark[1] = time([&] {
+        decimators.erase(&wave);
+        drawGraph(&scratch, minPt, maxPt, wave, 0xffffffff);
+    });
+    graphBenchmark[2] = time([&] {
+        drawGraph(&scratch, minPt, maxPt, wave, 0xffffffff);
+    });
+    decimators.erase(&wave);
 }
 
 
@@ -2,22 +2,34 @@
 #define har_h
 
 #include <fstream>
+#include <unordered_map>
 using namespace std;
 
 #include "graph_generators.hpp"
 #include "bargraph_generator.hpp"
 #include "states_info.hpp"
 #include "trajectory.hpp"
+#include "joint_filter.hpp"
+#include "gap_filler.hpp"
+#include "feature_extractor.hpp"
+#include "trajectory_predictor.hpp"
+#include "trajectory_forecast.hpp"
+#include "skeleton_renderer.hpp"
+#include "skeleton_topology.hpp"
+#include "live_graphs.hpp"
+#include "activity_classifier.hpp"
+#include "activity_states.hpp"
+#include "gesture_matcher.hpp"
 
 
 //namespace
 //{
-    extern void *GLUT_BITMAP_HELVETICA_18;
-    
     extern XnBool g_bDrawSkeleton;
     extern XnBool g_bPrintID;
     extern XnBool g_bPrintState;
+    extern skeleton::Profile g_SkeletonProfile;
     extern XnBool g_bPrintFrameID;
+    extern XnBool g_bTextBenchmark;
     
     extern History g_RightHandPositionHistory;
     extern History g_LeftHandPositionHistory;
@@ -28,19 +40,38 @@ using namespace std;
 //
 class OpenGLHelper
 {
+    const TrajectoryPredictor *predictor = nullptr;
+    const TrajectoryForecaster *forecaster = nullptr;
+    const JointFilterBank *jointFilters = nullptr;
+    const GapFiller *gaps = nullptr;
+    
+    SkeletonRenderer skeletonBatch;    // limbs, joints and hand markers of the current view
+    std::vector<float> trailXY;        // control points of the hand trail being drawn, reused across calls
+    
+    static const int MaxTrailSegments = 16;    // curve segments per hand trail, whatever the history length
+    
 public:
     void init();
+    void setJointFilterBank(const JointFilterBank *f) { jointFilters = f; }
+    void setGapFiller(const GapFiller *g) { gaps = g; }
+    void setTrajectoryPredictor(const TrajectoryPredictor *p) { predictor = p; }
+    void setTrajectoryForecaster(const TrajectoryForecaster *f) { forecaster = f; }
+    const SkeletonRenderer &skeletonRenderer() const { return skeletonBatch; }
     void beginFrame();
 
-    void glPrintString(void *font, const char *str, float scale=1.0f);
-    void drawSkeleton(bool isDepthView);
+    void glPrintString(float x, float y, const char *str, float scale=1.0f);
+    void drawSkeleton(bool isDepthView, float viewWidth, float viewHeight);
 
     void endFrame();
     
 private:
     void drawSkeletonCommon();
-    void drawSkeletonInRGBView();
-    void drawSkeletonInDepthView();
+    void drawSkeletonInRGBView(float viewWidth, float viewHeight);
+    void drawSkeletonInDepthView(float viewWidth, float viewHeight);
+    void drawTextBenchmark(float viewWidth, float viewHeight);
+    
+    bool GetJointPosition(xn::UserGenerator& userGenerator,
+                          XnUserID player, XnSkeletonJoint eJoint, XnSkeletonJointPosition &joint);
     
     void DrawLimb(xn::UserGenerator& userGenerator,
                   xn::DepthGenerator& depthGenerator,
@@ -61,16 +92,14 @@ private:
                    XnUserID player, XnSkeletonJoint eJoint, uint drawPointOptions,
                    ofstream *x_file=nullptr, bool addComma=true);
     
-    void Distance3D(xn::UserGenerator& userGenerator,
-                    xn::DepthGenerator& depthGenerator,
-                    XnUserID player, XnSkeletonJoint eJoint1, XnSkeletonJoint eJoint2);
-    
     void DrawCircle(xn::UserGenerator& userGenerator,
                     xn::DepthGenerator& depthGenerator,
                     XnUserID player, XnSkeletonJoint eJoint,
                     float radius, XnFloat *color3f);
     
     void DrawBezierCurve(const std::vector<XnPoint3D> &controlPoints, int numPoints = 16);
+    void drawPredictions(xn::DepthGenerator& depthGenerator, XnUserID player);
+    void drawForecastCones(xn::DepthGenerator& depthGenerator);
     
     void handtrajectory(xn::UserGenerator& userGenerator,
                         xn::DepthGenerator& depthGenerator,
@@ -93,17 +122,47 @@ private:
     
 // LeftPanel
     bool  bLeftPanelOpen = true;
+    bool  bRoiRecording = false;
     float someproperty0 = 3.14f;
     float someproperty1 = 2.718f;
     float someproperty2 = -1;
     
+// BottomPanel
+    GapFiller *gaps = nullptr;
+    JointFilterBank *jointFilters = nullptr;
+    FeatureExtractor *features = nullptr;
+    ActivityClassifier *classifier = nullptr;
+    ActivityStates *activityStates = nullptr;
+    GestureMatcher *gestures = nullptr;
+    double gestureBenchmark[4] = {};    // matches per second for 100, 200, 400, 800 templates
+    ActivityClassifier::Timing classifierBenchmark;  // 6 users, per frame
+    
 // RightPanel
     bool bRightPanelOpen = true;
+    LiveGraphs *liveGraphs = nullptr;
+    TrajectoryPredictor *predictor = nullptr;
+    TrajectoryForecaster *forecaster = nullptr;
+    const OpenGLHelper *ogl = nullptr;
+    std::unordered_map<const GraphGenerator *, GraphDecimator> decimators;
+    ImVector<ImVec2> graphPoints;       // drawGraph scratch, kept to avoid per-plot allocations
+    double frameMs = 0.0;
+    double graphBenchmark[3] = {};      // ms per 10k-sample plot: one line per segment, decimated, decimation cached
     enum RightPanelTab { HAND_TRAJECTORIES, PREDICTED_TRAJECTORIES, DISTANCE_GRAPH, ANGULAR_GRAPH };
     RightPanelTab currentRightPanelTab = HAND_TRAJECTORIES;
     
 public:
     MainPanelTab getCurrentMainPanelTab() { return currentMainPanelTab; }
+    bool isRoiRecording() { return bRoiRecording; }
+    void setGapFiller(GapFiller *g) { gaps = g; }
+    void setJointFilterBank(JointFilterBank *f) { jointFilters = f; }
+    void setFeatureExtractor(FeatureExtractor *f) { features = f; }
+    void setClassifier(ActivityClassifier *c) { classifier = c; }
+    void setActivityStates(ActivityStates *s) { activityStates = s; }
+    void setGestureMatcher(GestureMatcher *g) { gestures = g; }
+    void setLiveGraphs(LiveGraphs *g) { liveGraphs = g; }
+    void setTrajectoryPredictor(TrajectoryPredictor *p) { predictor = p; }
+    void setTrajectoryForecaster(TrajectoryForecaster *f) { forecaster = f; }
+    void setOpenGLHelper(const OpenGLHelper *o) { ogl = o; }
     
 public:
 // Screens
@@ -126,7 +185,6 @@ private:
 private:
     void drawHandTrajectories();
     void drawPredictedTrajectories();
-    void drawMultiplePredictedTrajectories();
     void drawDistanceGraph();
     void drawAngleGraph();
     
@@ -135,6 +193,7 @@ private:
     
     void drawGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, GraphGenerator &graph, ImU32 col);
     void drawGraph(ImDrawList* dl, ImVec2 minPt, ImVec2 maxPt, GraphGenerator &graph, ImU32 col, float minValue, float maxValue);
+    void benchmarkGraphs();
 };
 
 #endif /* har_h */
@@ -0,0 +1,186 @@
+#include "joint_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float MaxFrameGap = 0.5f;         // seconds: longer gaps restart the filters
+    const float MinConfidence = 0.5f;
+    const float InitialSpeed = 1000.0f;     // Kalman: millimeters per second, spread of the first velocity
+    const float TwoPi = 6.28318530718f;
+}
+
+
+// JointFilterBank
+//
+void JointFilterBank::update(uint64_t timestamp, const session::SkeletonRecord *users, int count)
+{
+    timer_.begin();
+
+    if (settings.mode != mode_)
+    {
+        // the states of the two filters do not carry over
+        mode_ = settings.mode;
+        std::fill(init_, init_ + Lanes, 0.0f);
+    }
+
+    // Scatter the frame into the lanes
+    std::fill(mask_, mask_ + Lanes, 0.0f);
+    for (int i = 0; i < count; ++i)
+    {
+        int slot = users_.acquire(users[i].userId, timestamp, [this](int stale) { resetLanes(stale); });
+        if (slot < 0) continue; // more users than slots
+
+        users_[slot].record = users[i];
+
+        // a lane steps from its own last measurement, so a joint coming back from occlusion
+        // is not stepped over one frame; after a long gap it starts again
+        const int base = slot * LanesPerUser;
+        for (int j = 0; j < JointCount; ++j)
+        {
+            const session::SkeletonJoint &joint = users[i].joints[j];
+            const bool bMeasured = joint.confidence >= MinConfidence;
+            for (int d = 0; d < 3; ++d)
+            {
+                const int lane = base + d * JointCount + j;
+                float dt = 0.0f;
+                if (bMeasured)
+                {
+                    dt = init_[lane] != 0.0f? (timestamp - measured_[lane]) * 1e-6f : 0.0f;
+                    if (!(dt > 0.0f && dt < MaxFrameGap))
+                    {
+                        init_[lane] = 0.0f;
+                        dt = 0.0f;
+                    }
+                    measured_[lane] = timestamp;
+                }
+                z_[lane] = (&joint.x)[d];
+                dt_[lane] = dt;
+                mask_[lane] = bMeasured? 1.0f : 0.0f;
+            }
+        }
+    }
+
+    if (mode_ == Kalman) kalman();
+    else oneEuro();
+
+    // Gather the filtered positions back into the records
+    for (int slot = 0; slot < MaxUsers; ++slot)
+    {
+        if (users_.userId(slot) == 0 || users_.lastSeen(slot) != timestamp) continue;
+        UserState &user = users_[slot];
+
+        const int base = slot * LanesPerUser;
+        for (int j = 0; j < JointCount; ++j)
+        {
+            session::SkeletonJoint &joint = user.record.joints[j];
+            if (init_[base + j] == 0.0f) continue; // never measured: keep the raw value
+            joint.x = x_[base + j];
+            joint.y = x_[base + JointCount + j];
+            joint.z = x_[base + 2 * JointCount + j];
+        }
+    }
+
+    timer_.end();
+}
+
+void JointFilterBank::removeUser(uint32_t userId)
+{
+    users_.remove(userId, [this](int slot) { resetLanes(slot); });
+}
+
+const session::SkeletonRecord *JointFilterBank::filtered(uint32_t userId) const
+{
+    const UserState *user = users_.state(userId);
+    return user? &user->record : nullptr;
+}
+
+bool JointFilterBank::position(uint32_t userId, XnSkeletonJoint joint, XnPoint3D &position) const
+{
+    int slot = users_.find(userId);
+    int j = joint - 1;
+    if (slot < 0 || j < 0 || j >= JointCount) return false;
+
+    const int lane = slot * LanesPerUser + j;
+    if (init_[lane] == 0.0f) return false;
+    position.X = x_[lane];
+    position.Y = x_[lane + JointCount];
+    position.Z = x_[lane + 2 * JointCount];
+    return true;
+}
+
+bool JointFilterBank::velocity(uint32_t userId, XnSkeletonJoint joint, XnVector3D &velocity) const
+{
+    int slot = users_.find(userId);
+    int j = joint - 1;
+    if (slot < 0 || j < 0 || j >= JointCount) return false;
+
+    const int lane = slot * LanesPerUser + j;
+    if (init_[lane] == 0.0f) return false;
+    velocity.X = v_[lane];
+    velocity.Y = v_[lane + JointCount];
+    velocity.Z = v_[lane + 2 * JointCount];
+    return true;
+}
+
+void JointFilterBank::resetLanes(int slot)
+{
+    std::fill(init_ + slot * LanesPerUser, init_ + (slot + 1) * LanesPerUser, 0.0f);
+}
+
+void JointFilterBank::oneEuro()
+{
+    const float tauD = 1.0f / (TwoPi * settings.derivativeCutoff);
+    const float minCutoff = settings.minCutoff, beta = settings.beta;
+
+    for (int i = 0; i < Lanes; ++i)
+    {
+        const float dt = dt_[i], z = z_[i], x = x_[i], v = v_[i];
+
+        // smoothed derivative of the measurements, then a cutoff that follows it
+        const float ad = dt / (dt + tauD);
+        const float vn = v + ad * ((z - previous_[i]) / std::max(dt, 1e-4f) - v);
+        const float tau = 1.0f / (TwoPi * (minCutoff + beta * std::fabs(vn)));
+        const float xn = x + dt / (dt + tau) * (z - x);
+
+        // blend by the masks, no branches: the first measurement of a lane starts at rest where it is
+        const float m = mask_[i], f = init_[i];
+        x_[i] = x + m * (f * xn + (1.0f - f) * z - x);
+        v_[i] = v + m * (f * vn - v);
+        previous_[i] += m * (z - previous_[i]);
+        init_[i] = std::max(f, m);
+    }
+}
+
+void JointFilterBank::kalman()
+{
+    const float q = settings.accelerationNoise * settings.accelerationNoise;
+    const float r = settings.measurementNoise * settings.measurementNoise;
+
+    for (int i = 0; i < Lanes; ++i)
+    {
+        const float dt = dt_[i], z = z_[i], x = x_[i], v = v_[i];
+
+        // predict, with acceleration noise integrated over the step
+        const float dt2 = dt * dt;
+        const float xp = x + v * dt;
+        const float p00 = p00_[i] + dt * (2.0f * p01_[i] + dt * p11_[i]) + 0.25f * q * dt2 * dt2;
+        const float p01 = p01_[i] + dt * p11_[i] + 0.5f * q * dt2 * dt;
+        const float p11 = p11_[i] + q * dt2;
+
+        // correct
+        const float s = 1.0f / (p00 + r);
+        const float k0 = p00 * s, k1 = p01 * s;
+        const float residual = z - xp;
+
+        // blend by the masks, as above; a first measurement starts with a wide velocity
+        const float m = mask_[i], f = init_[i], nf = 1.0f - f;
+        x_[i] = x + m * (f * (xp + k0 * residual) + nf * z - x);
+        v_[i] = v + m * (f * (v + k1 * residual) - v);
+        p00_[i] += m * (f * (1.0f - k0) * p00 + nf * r - p00_[i]);
+        p01_[i] += m * (f * (1.0f - k0) * p01 - p01_[i]);
+        p11_[i] += m * (f * (p11 - k1 * p01) + nf * InitialSpeed * InitialSpeed - p11_[i]);
+        init_[i] = std::max(f, m);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef joint_filter_hpp
+#define joint_filter_hpp
+
+#include <cstdint>
+
+#include <XnOpenNI.h>
+
+#include "session.hpp"
+#include "user_slots.hpp"
+
+// Joint filter bank
+//
+// Smooths every joint of every tracked user once per skeleton frame, for
+// the drawing code and the hand Histories; the raw skeletons still go to
+// the feature extractor. Two filters, chosen in 'settings':
+//  - One-Euro: a low-pass whose cutoff rises with speed, so joints at rest
+//    stop jittering while fast motion keeps little lag
+//  - Kalman: constant velocity per axis, white acceleration noise
+// Both also estimate the velocity of each joint.
+//
+// All users, axes and joints are one flat array of lanes, [user][axis][joint],
+// and each filter is one branch-free pass over all of them; users missing
+// from the frame and low confidence joints have a zero mask, which leaves
+// their lanes as they were.
+//
+class JointFilterBank
+{
+public:
+    enum Mode { OneEuro, Kalman };
+
+    static const int MaxUsers = MaxTrackedUsers;
+    static const int JointCount = session::SkeletonRecord::JointCount;
+    static const int LanesPerUser = 3 * JointCount;
+    static const int Lanes = MaxUsers * LanesPerUser;
+
+    struct Settings
+    {
+        Mode mode = OneEuro;
+        float minCutoff = 1.0f;             // One-Euro: hertz at rest
+        float beta = 0.005f;                // hertz per millimeter per second
+        float derivativeCutoff = 1.0f;      // hertz
+        float accelerationNoise = 2000.0f;  // Kalman: millimeters per second squared
+        float measurementNoise = 15.0f;     // millimeters
+    };
+
+    Settings settings;
+
+    void update(uint64_t timestamp, const session::SkeletonRecord *users, int count);
+    void removeUser(uint32_t userId);
+
+    /** The user's last frame, positions filtered and confidences as measured; nullptr if unknown */
+    const session::SkeletonRecord *filtered(uint32_t userId) const;
+
+    bool position(uint32_t userId, XnSkeletonJoint joint, XnPoint3D &position) const;
+    bool velocity(uint32_t userId, XnSkeletonJoint joint, XnVector3D &velocity) const; // millimeters per second
+
+    double averageUpdateMs() const { return timer_.averageMs(); }
+
+private:
+    struct UserState
+    {
+        session::SkeletonRecord record;     // filtered
+    };
+
+    void resetLanes(int slot);
+    void oneEuro();
+    void kalman();
+
+    UserSlots<UserState, MaxUsers> users_;
+
+    // Lanes
+    float z_[Lanes] = {};                   // measurement
+    float previous_[Lanes] = {};            // One-Euro: last measurement used
+    float dt_[Lanes] = {};                  // seconds since the lane's last measurement
+    uint64_t measured_[Lanes] = {};         // microseconds, time of the lane's last measurement
+    float mask_[Lanes] = {};                // 1 where this frame measured the joint, 0 leaves the lane as it is
+    float init_[Lanes] = {};                // 1 once the lane holds a state
+    float x_[Lanes] = {};                   // filtered position
+    float v_[Lanes] = {};                   // filtered velocity
+    float p00_[Lanes] = {}, p01_[Lanes] = {}, p11_[Lanes] = {}; // Kalman covariance
+
+    Mode mode_ = OneEuro;
+    UpdateTimer timer_;
+};
+
+#endif /* joint_filter_hpp */
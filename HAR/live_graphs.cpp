@@ -0,0 +1,61 @@
+#include "live_graphs.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float Pi = 3.14159265358979323846f;
+}
+
+
+// LiveGraphs
+//
+LiveGraphs::LiveGraphs(const TrajectoryPredictor &predictor)
+: handSpeed{ { Window, 0.0f, 3.0f }, { Window, 0.0f, 3.0f } }
+, handToTarget{ { Window, 0.0f, 2.0f }, { Window, 0.0f, 2.0f } }
+, headToHand{ { Window, 0.0f, 1500.0f }, { Window, 0.0f, 1500.0f } }
+, handToHand(Window, 0.0f, 1500.0f)
+, elbowAngle{ { Window, 0.0f, Pi }, { Window, 0.0f, Pi } }
+, kneeAngle{ { Window, 0.0f, Pi }, { Window, 0.0f, Pi } }
+, timeToContact{ { Window, 0.0f, predictor.settings.maxTimeToContact }, { Window, 0.0f, predictor.settings.maxTimeToContact } }
+{
+}
+
+void LiveGraphs::update(const FeatureExtractor &features, const TrajectoryPredictor &predictor, History &leftHand, History &rightHand)
+{
+    typedef FeatureExtractor FE;
+
+    uint32_t focus = features.focusUser();
+    bool bUpdated = false;
+    for (int i = 0; i < features.frameUserCount(); ++i)
+    {
+        if (features.frameUser(i) == focus) bUpdated = true;
+    }
+    if (!bUpdated) return;
+
+    const float *f = features.features(focus);
+    const int hands[2] = { FE::LeftHand, FE::RightHand };
+    History *histories[2] = { &leftHand, &rightHand };
+    for (int h = 0; h < 2; ++h)
+    {
+        float vx = f[FE::VelocityX + hands[h]], vy = f[FE::VelocityY + hands[h]], vz = f[FE::VelocityZ + hands[h]];
+        handSpeed[h].push(std::sqrt(vx * vx + vy * vy + vz * vz) * 0.001f);
+
+        if (histories[h]->Size() > 0) handToTarget[h].push(histories[h]->GetDistanceToTarget());
+
+        int target = predictor.likelyTarget(h);
+        const float maxTimeToContact = predictor.settings.maxTimeToContact;
+        float ttc = target >= 0? predictor.prediction(h, target).timeToContact : maxTimeToContact;
+        timeToContact[h].push(std::min(ttc, maxTimeToContact));
+    }
+
+    headToHand[0].push(f[FE::Distances + FE::HeadToLeftHand]);
+    headToHand[1].push(f[FE::Distances + FE::HeadToRightHand]);
+    handToHand.push(f[FE::Distances + FE::HandToHand]);
+
+    elbowAngle[0].push(f[FE::Angles + FE::LeftElbowAngle]);
+    elbowAngle[1].push(f[FE::Angles + FE::RightElbowAngle]);
+    kneeAngle[0].push(f[FE::Angles + FE::LeftKneeAngle]);
+    kneeAngle[1].push(f[FE::Angles + FE::RightKneeAngle]);
+}
@@ -0,0 +1,35 @@
+#ifndef live_graphs_hpp
+#define live_graphs_hpp
+
+#include "graph_generators.hpp"
+#include "feature_extractor.hpp"
+#include "trajectory.hpp"
+#include "trajectory_predictor.hpp"
+
+// Live graphs
+//
+// Series plotted by the right panel tabs. The analytics side pushes one
+// sample per skeleton frame, the GUI reads them through the lock-free
+// TimeSeriesGraphGenerator, so neither waits for the other. All series
+// follow the focus user of the feature extractor.
+//
+struct LiveGraphs
+{
+    static const int Window = 3600; // samples: 2 minutes at 30 Hz
+
+    TimeSeriesGraphGenerator handSpeed[2];      // left, right; meters per second
+    TimeSeriesGraphGenerator handToTarget[2];   // left, right; meters
+    TimeSeriesGraphGenerator headToHand[2];     // left, right; millimeters
+    TimeSeriesGraphGenerator handToHand;        // millimeters
+    TimeSeriesGraphGenerator elbowAngle[2];     // left, right; radians
+    TimeSeriesGraphGenerator kneeAngle[2];      // left, right; radians
+    TimeSeriesGraphGenerator timeToContact[2];  // left, right; seconds to the likely target, the predictor's maxTimeToContact if none
+
+    /** The time to contact graphs span the predictor's range */
+    explicit LiveGraphs(const TrajectoryPredictor &predictor);
+
+    /** Push the samples of the last feature update, if it saw the focus user */
+    void update(const FeatureExtractor &features, const TrajectoryPredictor &predictor, History &leftHand, History &rightHand);
+};
+
+#endif /* live_graphs_hpp */
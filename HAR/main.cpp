@@ -6,12 +6,12 @@
 //{
     const char *gWindowName = "Human Activity Prediction";
     
-    void *GLUT_BITMAP_HELVETICA_18 = nullptr;
-    
     XnBool g_bDrawSkeleton = TRUE;
     XnBool g_bPrintID = TRUE;
     XnBool g_bPrintState = TRUE;
     XnBool g_bPrintFrameID = FALSE;
+    XnBool g_bTextBenchmark = FALSE;
+    skeleton::Profile g_SkeletonProfile = skeleton::FullBody;
     
     History g_RightHandPositionHistory;
     History g_LeftHandPositionHistory;
@@ -28,9 +28,29 @@ class Application
     gfx::RGBFeed rgbFeed;
     gfx::RenderToTexture rtt;
     
+    XnUInt32 lastDepthFrameId = 0;
+    XnUInt32 lastSkeletonFrameId = 0;
+    
+    // Tracked skeletons of the latest user frame
+    session::SkeletonRecord skeletons[ActivityClassifier::MaxUsers];
+    int skeletonCount = 0;
+    
+    GapFiller gaps;
+    JointFilterBank jointFilters;
+    FeatureExtractor features;
+    ActivityClassifier classifier;
+    ActivityStates activityStates;
+    GestureMatcher gestures;
+    TrajectoryPredictor predictor;
+    TrajectoryForecaster forecaster;
+    LiveGraphs liveGraphs{ predictor };
+    
 private:
     void drawFunction(window::Layer layer);
     void sensorFunction(sensor::Message mssg, XnUserID id);
+    bool updateSkeletons();
+    void updatePredictor(uint64_t timestamp);
+    void recordSensorFrame(bool bNewSkeletons);
 
 public:
     Application();
@@ -54,16 +74,36 @@ int main(int argc, char *argv[])
 //
 Application::Application()
 {
+    session::output().open(OutputData::GetOutputDir() + "session.har");
+    features.openLog(OutputData::CreateCSVFilename("Features"));
+    gaps.openLog(OutputData::CreateCSVFilename("Joints"));
+    
     window::create(gWindowName, [this](window::Layer layer) {
         drawFunction(layer);
-    }, window::UseLegacyOpenGL);
+    });
     
     sensor::start([this](sensor::Message mssg, XnUserID id) {
         sensorFunction(mssg, id);
     });
 
     ogl.init();
+    ogl.setJointFilterBank(&jointFilters);
+    ogl.setGapFiller(&gaps);
     gui.init();
+    gui.setJointFilterBank(&jointFilters);
+    gui.setGapFiller(&gaps);
+    gui.setFeatureExtractor(&features);
+    gui.setClassifier(&classifier);
+    gui.setActivityStates(&activityStates);
+    
+    gestures.loadLibrary("data/gestures");
+    gui.setGestureMatcher(&gestures);
+    gui.setLiveGraphs(&liveGraphs);
+    gui.setTrajectoryPredictor(&predictor);
+    ogl.setTrajectoryPredictor(&predictor);
+    gui.setTrajectoryForecaster(&forecaster);
+    gui.setOpenGLHelper(&ogl);
+    ogl.setTrajectoryForecaster(&forecaster);
 }
 
 int Application::run()
@@ -73,12 +113,156 @@ int Application::run()
         //std::this_thread::sleep_for(std::chrono::milliseconds(33));
         
         sensor::updateAll();
+        
+        bool bNewSkeletons = updateSkeletons();
+        if (bNewSkeletons)
+        {
+            auto timestamp = sensor::userGenerator().GetTimestamp();
+            gaps.update(timestamp, skeletons, skeletonCount);
+            jointFilters.update(timestamp, skeletons, skeletonCount);
+            features.update(timestamp, gaps.filled(), skeletonCount);
+            
+            // one focus user for every panel
+            classifier.setFocusUser(features.focusUser());
+            activityStates.setFocusUser(features.focusUser());
+            
+            classifier.update(timestamp, features);
+            for (int i = 0; i < features.frameUserCount(); ++i)
+            {
+                auto userId = features.frameUser(i);
+                activityStates.update(timestamp, userId, classifier.probabilities(userId), classifier.descriptors(userId));
+            }
+            updatePredictor(timestamp);
+            liveGraphs.update(features, predictor, g_LeftHandPositionHistory, g_RightHandPositionHistory);
+        }
+        
+        if (gui.currentScreen == GUIHelper::Screen::SingleTarget)
+        {
+            gestures.update(g_LeftHandPositionHistory, g_RightHandPositionHistory);
+        }
+        forecaster.update(g_LeftHandPositionHistory, g_RightHandPositionHistory);
+        
+        recordSensorFrame(bNewSkeletons);
+        
+        // one batch per frame: this frame's depth and skeletons, and the video frames of the previous draw
+        session::output().flush();
     }
     while(window::updateAll());
     
+    session::output().close();
+    
     return 0;
 }
 
+bool Application::updateSkeletons()
+{
+    if (!sensor::initialized()) return false;
+    
+    auto &userGenerator = sensor::userGenerator();
+    if (userGenerator.GetFrameID() == lastSkeletonFrameId) return false;
+    lastSkeletonFrameId = userGenerator.GetFrameID();
+    
+    XnUserID aUsers[ActivityClassifier::MaxUsers];
+    XnUInt16 nUsers = ActivityClassifier::MaxUsers;
+    userGenerator.GetUsers(aUsers, nUsers);
+    
+    skeletonCount = 0;
+    for (int i = 0; i < nUsers; ++i)
+    {
+        if (!userGenerator.GetSkeletonCap().IsTracking(aUsers[i])) continue;
+        
+        session::SkeletonRecord &record = skeletons[skeletonCount++];
+        record = session::SkeletonRecord();
+        record.userId = aUsers[i];
+        record.jointCount = session::SkeletonRecord::JointCount;
+        for (int k = 0; k < session::SkeletonRecord::JointCount; ++k)
+        {
+            XnSkeletonJointPosition joint;
+            if (userGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], (XnSkeletonJoint)(k + 1), joint) != XN_STATUS_OK) continue;
+            
+            record.joints[k] = { joint.position.X, joint.position.Y, joint.position.Z, joint.fConfidence };
+        }
+    }
+    return true;
+}
+
+void Application::updatePredictor(uint64_t timestamp)
+{
+    uint32_t focus = features.focusUser();
+    const session::SkeletonRecord *user = nullptr;
+    for (int i = 0; i < skeletonCount; ++i)
+    {
+        if (skeletons[i].userId == focus) user = &skeletons[i];
+    }
+    if (!user) return;
+    
+    // The head of the focus user, and in the multi target screen the heads of everyone else too
+    XnPoint3D targets[TrajectoryPredictor::MaxTargets];
+    int targetCount = 0;
+    auto addHead = [&](const session::SkeletonRecord &record) {
+        if (targetCount == TrajectoryPredictor::MaxTargets) return;
+        auto &head = record.joints[XN_SKEL_HEAD - 1];
+        targets[targetCount].X = head.x;
+        targets[targetCount].Y = head.y;
+        targets[targetCount].Z = head.z;
+        ++targetCount;
+    };
+    addHead(*user);
+    if (gui.currentScreen == GUIHelper::Screen::MultiTarget)
+    {
+        for (int i = 0; i < skeletonCount; ++i)
+        {
+            if (&skeletons[i] != user) addHead(skeletons[i]);
+        }
+    }
+    
+    predictor.setTargets(targets, targetCount);
+    predictor.update(timestamp, *user);
+}
+
+void Application::recordSensorFrame(bool bNewSkeletons)
+{
+    if (!sensor::initialized()) return;
+    
+    if (!session::output().isOpen()) return;
+    
+    auto &policy = session::policy();
+    
+    // Recording trigger
+    {
+        float handSpeed = std::max(g_LeftHandPositionHistory.Speed(), g_RightHandPositionHistory.Speed());
+        
+        policy.update(sensor::depthGenerator().GetTimestamp(), skeletonCount > 0, handSpeed);
+    }
+    
+    // Depth map
+    {
+        xn::DepthMetaData dmd;
+        sensor::depthGenerator().GetMetaData(dmd);
+        
+        if (dmd.FrameID() != lastDepthFrameId)
+        {
+            lastDepthFrameId = dmd.FrameID();
+            
+            session::DepthHeader header = {};
+            header.width = dmd.XRes();
+            header.height = dmd.YRes();
+            policy.append(session::ChunkType::Depth, dmd.FrameID(), dmd.Timestamp(),
+                          &header, sizeof(header), dmd.Data(), dmd.DataSize());
+        }
+    }
+    
+    // Skeletons of tracked users
+    if (bNewSkeletons)
+    {
+        auto &userGenerator = sensor::userGenerator();
+        for (int i = 0; i < skeletonCount; ++i)
+        {
+            policy.append(session::ChunkType::Skeleton, userGenerator.GetFrameID(), userGenerator.GetTimestamp(), &skeletons[i], sizeof(skeletons[i]));
+        }
+    }
+}
+
 void Application::drawFunction(window::Layer layer)
 {
     switch (layer)
@@ -87,33 +271,30 @@ void Application::drawFunction(window::Layer layer)
         ogl.beginFrame();
         if (gui.currentScreen != GUIHelper::Screen::Startup)
         {
-            glMatrixMode(GL_PROJECTION);
-            glLoadIdentity();
-            
+            rgbFeed.setRecordingMode(gui.isRoiRecording()? gfx::RGBFeed::RecordingMode::UserRoi : gfx::RGBFeed::RecordingMode::FullFrame);
             rgbFeed.update(); // always update RGB even when in Depth View mode. Because we are writing RGB to the disk.
             
             if (gui.getCurrentMainPanelTab() == GUIHelper::MainPanelTab::RGB)
             {
-                glOrtho(0, rgbFeed.logicalWidth(), 0, rgbFeed.logicalHeight(), -1.0, 1.0);
-                
-                if (rtt.begin(&rgbFeed))
+                // the overlay gets its own layer, composited over the camera image by the GUI
+                if (rtt.beginOverlay(&rgbFeed))
                 {
-                    ogl.drawSkeleton(false);
+                    ogl.drawSkeleton(false, rgbFeed.logicalWidth(), rgbFeed.logicalHeight());
+                    rgbFeed.captureFramebuffer();
+                }
+                else
+                {
+                    rgbFeed.capturePlainFrame(); // RenderToTexture has said why, once
                 }
-                
-                rgbFeed.captureFramebuffer();
-                
                 rtt.end();
             }
             else if (gui.getCurrentMainPanelTab() == GUIHelper::MainPanelTab::DEPTH)
             {
                 depthViz.update();
                 
-                glOrtho(0, depthViz.logicalWidth(), 0, depthViz.logicalHeight(), -1.0, 1.0);
-                
-                if (rtt.begin(&depthViz))
+                if (rtt.beginOverlay(&depthViz))
                 {
-                    ogl.drawSkeleton(true);
+                    ogl.drawSkeleton(true, depthViz.logicalWidth(), depthViz.logicalHeight());
                 }
                 rtt.end();
             }
@@ -133,12 +314,25 @@ void Application::drawFunction(window::Layer layer)
 
 void Application::sensorFunction(sensor::Message mssg, XnUserID id)
 {
+    if (sensor::initialized())
+    {
+        session::EventRecord record = { (uint32_t)mssg, id };
+        auto &depthGenerator = sensor::depthGenerator();
+        session::policy().append(session::ChunkType::Event, depthGenerator.GetFrameID(), depthGenerator.GetTimestamp(), &record, sizeof(record));
+    }
+    
     switch(mssg)
     {
     case sensor::Message::NewUser:
         break;
         
     case sensor::Message::LostUser:
+        gaps.removeUser(id);
+        jointFilters.removeUser(id);
+        features.removeUser(id);
+        if (predictor.userId() == id) predictor.reset();
+        classifier.removeUser(id);
+        activityStates.removeUser(id);
         break;
         
     default:
@@ -13,50 +13,68 @@ void OpenGLHelper::init()
     
     boost::filesystem::create_directory(OutputData::GetOutputDir() + "Trajectory");
     boost::filesystem::create_directory(OutputData::GetOutputDir() + "JointPositionData");
+    
+    // compile (or load) the overlay programs before the first frame rather than during it
+    skeletonBatch.prepare();
+    gfx::prepareText();
 }
 
 void OpenGLHelper::beginFrame()
 {
     glClear(GL_COLOR_BUFFER_BIT);
-    
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
 }
 
 void OpenGLHelper::endFrame()
 {
 }
 
-void OpenGLHelper::glPrintString(void *font, const char *str, float scale)
+void OpenGLHelper::glPrintString(float x, float y, const char *str, float scale)
 {
-    GLint pos[4];
-    glGetIntegerv(GL_CURRENT_RASTER_POSITION, pos);
-    
-    float x = pos[0];
-    float y = pos[1];
     gfx::drawString(x, y, str, scale);
-    
-    /*size_t i,l = strlen(str);
-    
-    for(i=0; i<l; i++)
-    {
-        //glutBitmapCharacter(font,*str++);
-    }*/
 }
 
-void OpenGLHelper::drawSkeleton(bool isDepthView)
+void OpenGLHelper::drawSkeleton(bool isDepthView, float viewWidth, float viewHeight)
 {
     if (!sensor::initialized()) return;
     
-    glDisable(GL_TEXTURE_2D);
     glDisable(GL_DEPTH_TEST);
     
     drawSkeletonCommon();
     
-    if (isDepthView) drawSkeletonInDepthView();
-    else drawSkeletonInRGBView();
+    if (isDepthView) drawSkeletonInDepthView(viewWidth, viewHeight);
+    else drawSkeletonInRGBView(viewWidth, viewHeight);
+    
+    if (g_bTextBenchmark) drawTextBenchmark(viewWidth, viewHeight);
     
-    glEnable(GL_TEXTURE_2D);
+    // Every label of the view in one draw, on top
+    gfx::flushStrings(viewWidth, viewHeight);
+}
+
+void OpenGLHelper::drawTextBenchmark(float viewWidth, float viewHeight)
+{
+    // A grid of joint-label-like strings, several times what a full room of users produces
+    const int columns = 8, rows = 16;
+    char strLabel[50];
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            int x = (column + 0.1f) * viewWidth / columns;
+            int y = (row + 0.5f) * viewHeight / rows;
+            sprintf(strLabel, "(%d, %d) ", x, y);
+            gfx::drawString(x, y, strLabel);
+        }
+    }
+}
+
+//Joint position, smoothed by the filter bank when there is one
+bool OpenGLHelper::GetJointPosition(xn::UserGenerator& userGenerator,
+                                    XnUserID player, XnSkeletonJoint eJoint, XnSkeletonJointPosition &joint)
+{
+    if (userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint, joint) != XN_STATUS_OK) return false;
+    
+    if (jointFilters) jointFilters->position(player, eJoint, joint.position);
+    return true;
 }
 
 void OpenGLHelper::DrawLimb(xn::UserGenerator& userGenerator,
@@ -70,8 +88,8 @@ void OpenGLHelper::DrawLimb(xn::UserGenerator& userGenerator,
     }
     
     XnSkeletonJointPosition joint1, joint2;
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint1, joint1);
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint2, joint2);
+    GetJointPosition(userGenerator, player, eJoint1, joint1);
+    GetJointPosition(userGenerator, player, eJoint2, joint2);
     
     if (joint1.fConfidence < 0.5 || joint2.fConfidence < 0.5)
     {
@@ -84,8 +102,7 @@ void OpenGLHelper::DrawLimb(xn::UserGenerator& userGenerator,
     
     depthGenerator.ConvertRealWorldToProjective(2, pt, pt);
     
-    glVertex3i(pt[0].X, pt[0].Y, 0);
-    glVertex3i(pt[1].X, pt[1].Y, 0);
+    skeletonBatch.addLine(pt[0].X, pt[0].Y, pt[1].X, pt[1].Y);
 }
 
 void OpenGLHelper::DrawJoint(xn::UserGenerator& userGenerator,
@@ -101,37 +118,20 @@ void OpenGLHelper::DrawJoint(xn::UserGenerator& userGenerator,
         return;
     }
     XnSkeletonJointPosition joint;
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint, joint);
+    GetJointPosition(userGenerator, player, eJoint, joint);
     if (joint.fConfidence < 0.5){
         return;}
     
     XnPoint3D pt[2];
     pt[0] = joint.position;
     depthGenerator.ConvertRealWorldToProjective(1, pt, pt);
-    glVertex2f(pt[0].X, pt[0].Y);
+    skeletonBatch.addPoint(pt[0].X, pt[0].Y);
 }
 
 const char *OpenGLHelper::GetJointName (XnSkeletonJoint eJoint)
 {
-    switch (eJoint)
-    {
-        case XN_SKEL_HEAD: return "head";
-        case XN_SKEL_NECK: return "neck";
-        case XN_SKEL_LEFT_SHOULDER: return "left shoulder";
-        case XN_SKEL_LEFT_ELBOW: return "left elbow";
-        case XN_SKEL_RIGHT_SHOULDER: return "right shoulder";
-        case XN_SKEL_RIGHT_ELBOW: return "right elbow";
-        case XN_SKEL_TORSO: return "torse";
-        case XN_SKEL_LEFT_HIP: return "left hip";
-        case XN_SKEL_LEFT_KNEE: return "left knee";
-        case XN_SKEL_LEFT_FOOT: return "left foot";
-        case XN_SKEL_RIGHT_KNEE: return "right knee";
-        case XN_SKEL_RIGHT_FOOT: return "right foot";
-        case XN_SKEL_RIGHT_HAND: return "right hand";
-        case XN_SKEL_LEFT_HAND: return "left hand";
-        default: return "Joint";
-    };
-    return "Joint";
+    int j = skeleton::indexOf(eJoint);
+    return j >= 0? skeleton::Joints[j].label : "Joint";
 }
 
 void OpenGLHelper::DrawPoint(xn::UserGenerator& userGenerator,
@@ -151,12 +151,20 @@ void OpenGLHelper::DrawPoint(xn::UserGenerator& userGenerator,
     
     if (g_bPrintID){
         XnSkeletonJointPosition joint;
-        userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint, joint);
+        GetJointPosition(userGenerator, player, eJoint, joint);
         
         if (joint.fConfidence < 0.5){
             if (p_x_file) {
                 ofstream &x_file = *p_x_file;
-                x_file << "[,,]" << (addComma? "; " : "");
+                XnPoint3D pt;
+                GapFiller::Quality quality;
+                if (gaps && gaps->position(player, eJoint, pt, quality)) {
+                    // filled, marked with the quality: [x, y, z]2 when extrapolated
+                    depthGenerator.ConvertRealWorldToProjective(1, &pt, &pt);
+                    x_file << "[" << (int)pt.X << ", " << (int)pt.Y << ", " << (int)pt.Z << "]" << (int)quality;
+                    if (addComma) x_file << ";";
+                }
+                else x_file << "[,,]" << (addComma? "; " : "");
             }
             return;
         }
@@ -167,14 +175,11 @@ void OpenGLHelper::DrawPoint(xn::UserGenerator& userGenerator,
             depthGenerator.ConvertRealWorldToProjective(1, pt, pt);
             if (!p_x_file)
             {
-                glVertex2f(pt[0].X, pt[0].Y);
                 if (drawPointOptions & DRAW_NAME)
                     sprintf(strLabel, "%s ", GetJointName(eJoint));
                 else if (drawPointOptions & DRAW_POSITION)
                     sprintf(strLabel, "(%.0f, %.0f) ", pt[0].X,pt[0].Y);
-                glColor3f(1.f,1.f,1.f);
-                glRasterPos2i(pt[0].X, pt[0].Y);
-                glPrintString(GLUT_BITMAP_HELVETICA_18, strLabel);
+                glPrintString(pt[0].X, pt[0].Y, strLabel);
             }
             if (p_x_file) {
                 ofstream &x_file = *p_x_file;
@@ -187,50 +192,13 @@ void OpenGLHelper::DrawPoint(xn::UserGenerator& userGenerator,
     }
 }
 
-void OpenGLHelper::Distance3D(xn::UserGenerator& userGenerator,
-                xn::DepthGenerator& depthGenerator,
-                XnUserID player, XnSkeletonJoint eJoint1, XnSkeletonJoint eJoint2)
-{
-    char strLabel[50] = "";
-    xnOSMemSet(strLabel, 0, sizeof(strLabel));
-    
-    if (!userGenerator.GetSkeletonCap().IsTracking(player))
-    {
-        printf("not tracked!\n");
-        return;
-    }
-    
-    XnSkeletonJointPosition joint1, joint2;
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint1, joint1);
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint2, joint2);
-    
-    if (joint1.fConfidence < 0.5 || joint2.fConfidence < 0.5)
-    {
-        return;
-    }
-    
-    
-    XnVector3D v;
-    v.X = joint1.position.X - joint2.position.X;
-    v.Y = joint1.position.Y - joint2.position.Y;
-    v.Z = joint1.position.Z - joint2.position.Z;
-    float distance3D = sqrt(v.X * v.X + v.Y * v.Y + v.Z * v.Z);
-    
-    float dist = sqrt(distance3D * distance3D) * 0.001f;
-    sprintf(strLabel, " Distance between %s, and %s, :(%.03fm) ", GetJointName(eJoint1), GetJointName(eJoint2), dist);
-    glColor3f(1.f,1.f,1.f);
-    glRasterPos2i(20, (eJoint2 == XN_SKEL_RIGHT_HAND)? 80 : 110);
-    glPrintString(GLUT_BITMAP_HELVETICA_18, strLabel, 0.75f);
-    
-}
-
 void OpenGLHelper::DrawCircle(xn::UserGenerator& userGenerator,
                 xn::DepthGenerator& depthGenerator,
                 XnUserID player, XnSkeletonJoint eJoint, float radius, XnFloat *color3f)
 {
     
     XnSkeletonJointPosition joint;
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint, joint);
+    GetJointPosition(userGenerator, player, eJoint, joint);
     
     if (joint.fConfidence < 0.5){
         return;
@@ -239,26 +207,8 @@ void OpenGLHelper::DrawCircle(xn::UserGenerator& userGenerator,
     XnPoint3D pt;
     pt = joint.position;
     depthGenerator.ConvertRealWorldToProjective(1, &pt, &pt);
-    float cx = pt.X;
-    float cy = pt.Y;
-    float r = radius;
-    int num_segments = 16;
-    
-    glColor3f(color3f[0], color3f[1], color3f[2]);
-    
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx , cy);
-    for(int i = 0; i <= num_segments; i++)
-    {
-        float theta = 2.0f * 3.1415926f * float(i) / float(num_segments);//get the current angle
-        
-        float x = r * cosf(theta);//calculate the x component
-        float y = r * sinf(theta);//calculate the y component
-        
-        glVertex2f(x +cx , y + cy);//output vertex
-        
-    }
-    glEnd();
+    skeletonBatch.setColor(color3f[0], color3f[1], color3f[2]);
+    skeletonBatch.addDisc(pt.X, pt.Y, radius);
 }
 
 //Function Struct History is called from trajectory.h (file)
@@ -281,15 +231,143 @@ bool GetHistoryForJoint (XnSkeletonJoint eJoint, History **history) {
     return true;
 }
 
+void OpenGLHelper::DrawBezierCurve(const std::vector<XnPoint3D> &controlPoints, int numPoints)
+{
+    if (controlPoints.size() < 2 || numPoints < 2) return;
+    
+    // cubics are tessellated by the renderer
+    if (controlPoints.size() == 4)
+    {
+        float xy[8];
+        for (int k = 0; k < 4; ++k)
+        {
+            xy[2 * k] = controlPoints[k].X;
+            xy[2 * k + 1] = controlPoints[k].Y;
+        }
+        skeletonBatch.addBezier(xy);
+        return;
+    }
+    
+    // de Casteljau, any degree
+    std::vector<XnPoint3D> work(controlPoints.size());
+    std::vector<float> xy;
+    for (int i = 0; i < numPoints; ++i)
+    {
+        float u = i / (float)(numPoints - 1);
+        work = controlPoints;
+        for (size_t n = work.size() - 1; n > 0; --n)
+        {
+            for (size_t k = 0; k < n; ++k)
+            {
+                work[k].X += u * (work[k + 1].X - work[k].X);
+                work[k].Y += u * (work[k + 1].Y - work[k].Y);
+                work[k].Z += u * (work[k + 1].Z - work[k].Z);
+            }
+        }
+        xy.push_back(work[0].X);
+        xy.push_back(work[0].Y);
+    }
+    skeletonBatch.addPolyline(xy.data(), numPoints);
+}
+
+//Draw predicted hand paths toward the targets, and the approach curve to the likely one
+void OpenGLHelper::drawPredictions(xn::DepthGenerator& depthGenerator, XnUserID player)
+{
+    if (!predictor || predictor->userId() != player) return;
+    
+    const int N = TrajectoryPredictor::Steps + 1;
+    for (int hand = 0; hand < TrajectoryPredictor::HandCount; ++hand)
+    {
+        if (!predictor->isTracking(hand)) continue;
+        
+        int likely = predictor->likelyTarget(hand);
+        for (int target = 0; target < predictor->targetCount(); ++target)
+        {
+            auto &prediction = predictor->prediction(hand, target);
+            
+            XnPoint3D path[N];
+            depthGenerator.ConvertRealWorldToProjective(N, prediction.path, path);
+            
+            float xy[2 * N];
+            for (int k = 0; k < N; ++k)
+            {
+                xy[2 * k] = path[k].X;
+                xy[2 * k + 1] = path[k].Y;
+            }
+            skeletonBatch.setLineWidth(target == likely? 3 : 1);
+            skeletonBatch.setColor(1.f, 0.5f + 0.5f * prediction.blend, 0.f, 1.f);
+            skeletonBatch.addPolyline(xy, N);
+        }
+        
+        if (likely >= 0)
+        {
+            std::vector<XnPoint3D> controlPoints(4);
+            depthGenerator.ConvertRealWorldToProjective(4, predictor->prediction(hand, likely).controlPoints, controlPoints.data());
+            
+            skeletonBatch.setLineWidth(1);
+            skeletonBatch.setColor(1.f, 1.f, 1.f, 0.5f);
+            DrawBezierCurve(controlPoints);
+        }
+    }
+}
+
+//Draw the forecast spread of each hand: the 90% band, then the 50% band over it
+void OpenGLHelper::drawForecastCones(xn::DepthGenerator& depthGenerator)
+{
+    if (!forecaster) return;
+    
+    const int N = TrajectoryForecaster::Steps + 1;
+    for (int hand = 0; hand < TrajectoryForecaster::HandCount; ++hand)
+    {
+        auto &cone = forecaster->cone(hand);
+        if (!cone.bValid) continue;
+        
+        // Centers, and a point one band radius to the side of each, in pixels
+        XnPoint3D world[3 * N], screen[3 * N];
+        for (int k = 0; k < N; ++k)
+        {
+            world[k] = world[N + k] = world[2 * N + k] = cone.center[k];
+            world[N + k].X += cone.radius90[k];
+            world[2 * N + k].X += cone.radius50[k];
+        }
+        depthGenerator.ConvertRealWorldToProjective(3 * N, world, screen);
+        
+        XnFloat *color = (hand == TrajectoryForecaster::Left? g_LeftHandPositionHistory : g_RightHandPositionHistory).Color();
+        for (int band = 1; band <= 2; ++band)
+        {
+            skeletonBatch.setColor(color[0], color[1], color[2], band == 1? 0.2f : 0.35f);
+            float left[N][2], right[N][2];
+            for (int k = 0; k < N; ++k)
+            {
+                // offset across the screen path
+                const XnPoint3D &c = screen[k];
+                const XnPoint3D &a = screen[k > 0? k - 1 : 0], &b = screen[k < N - 1? k + 1 : N - 1];
+                float dx = b.X - a.X, dy = b.Y - a.Y, length = sqrtf(dx * dx + dy * dy);
+                float nx = length > 1e-3f? -dy / length : 0.f, ny = length > 1e-3f? dx / length : 1.f;
+                float r = fabsf(screen[band * N + k].X - c.X);
+                left[k][0] = c.X + nx * r; left[k][1] = c.Y + ny * r;
+                right[k][0] = c.X - nx * r; right[k][1] = c.Y - ny * r;
+            }
+            for (int k = 1; k < N; ++k)
+            {
+                skeletonBatch.addTriangle(left[k - 1][0], left[k - 1][1], right[k - 1][0], right[k - 1][1], left[k][0], left[k][1]);
+                skeletonBatch.addTriangle(right[k - 1][0], right[k - 1][1], right[k][0], right[k][1], left[k][0], left[k][1]);
+            }
+        }
+    }
+}
+
 //Draw hand trajectory at each frame
 void OpenGLHelper::handtrajectory(xn::UserGenerator& userGenerator,
                     xn::DepthGenerator& depthGenerator,
                     XnUserID player, XnSkeletonJoint eJoint, bool updateHistory)
 {
     XnSkeletonJointPosition joint;
-    userGenerator.GetSkeletonCap().GetSkeletonJointPosition(player, eJoint, joint);
+    GetJointPosition(userGenerator, player, eJoint, joint);
     
-    if (joint.fConfidence < 0.5){
+    // below confidence, go on with the gap filler's estimate as long as it has one
+    GapFiller::Quality quality = GapFiller::Measured;
+    if (joint.fConfidence < 0.5 && !(gaps && gaps->position(player, eJoint, joint.position, quality))){
         return;
     }
     
@@ -316,32 +394,50 @@ void OpenGLHelper::handtrajectory(xn::UserGenerator& userGenerator,
     History *history;
     if (GetHistoryForJoint (eJoint, &history) == false) return;
     
-    if (updateHistory) history->StoreValue (pt_world, pt_screen); // store value in the history
+    if (updateHistory) // store value in the history
+    {
+        XnVector3D velocity_world;
+        if (jointFilters && jointFilters->velocity(player, eJoint, velocity_world))
+        {
+            // pixels per second, from where the hand would be a tenth of a second on
+            XnPoint3D ahead = pt_world, ahead_screen;
+            ahead.X += velocity_world.X * 0.1f;
+            ahead.Y += velocity_world.Y * 0.1f;
+            ahead.Z += velocity_world.Z * 0.1f;
+            depthGenerator.ConvertRealWorldToProjective(1, &ahead, &ahead_screen);
+            
+            XnVector3D velocity_screen;
+            velocity_screen.X = (ahead_screen.X - pt_screen.X) * 10.0f;
+            velocity_screen.Y = (ahead_screen.Y - pt_screen.Y) * 10.0f;
+            velocity_screen.Z = 0.0f;
+            history->StoreValue (pt_world, pt_screen, velocity_world, velocity_screen, quality);
+        }
+        else history->StoreValue (pt_world, pt_screen, quality);
+    }
     
     // Visualize history
     //
-    XnFloat pVertexBuffer [HISTORY_DRAW_SIZE * sizeof (float) * 3];
-    XnFloat *pVertex = pVertexBuffer;
-    
-    // Prepare vertex buffer for drawing
+    skeletonBatch.setColor(0.f, 1.f, 0.f);
+    skeletonBatch.setLineWidth(2);
+    skeletonBatch.setPointSize(8);
+    
+    // newest first: the trail fades out toward the oldest point. Every sample
+    // gets a marker, but the curve only goes through every 'stride'-th one and
+    // the oldest, so a trail is at most MaxTrailSegments curve segments
+    int count = history->Size();
+    int stride = std::max(1, (count - 2) / MaxTrailSegments + 1);
     XnPoint3D pt;
-    for (int k = 0; k < history->Size(); ++k) {
+    trailXY.clear();
+    for (int k = 0; k < count; ++k) {
         history->GetValueScreen (k, pt);
         
-        *pVertex++ = pt.X;
-        *pVertex++ = pt.Y;
-        *pVertex++ = 0.0f;
+        if (k % stride == 0 || k == count - 1) {
+            trailXY.push_back(pt.X);
+            trailXY.push_back(pt.Y);
+        }
+        skeletonBatch.addPoint(pt.X, pt.Y);
     }
-    
-    glColor3f(0.f, 1.f, 0.f);
-    glVertexPointer(3, GL_FLOAT, 0, pVertexBuffer);
-    
-    // draw trajectory
-    glLineWidth(2);
-    glDrawArrays(GL_LINE_STRIP, 0, history->Size());
-    
-    glPointSize(8);
-    glDrawArrays(GL_POINTS, 0, history->Size());
+    skeletonBatch.addPolyline(trailXY.data(), (int)trailXY.size() / 2, 0.2f);
 }
 
 void OpenGLHelper::drawSkeletonCommon()
@@ -359,7 +455,7 @@ void OpenGLHelper::drawSkeletonCommon()
         // Update targets for hand history objects
         {
             XnSkeletonJointPosition headJoint;
-            userGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_HEAD, headJoint);
+            GetJointPosition(userGenerator, aUsers[i], XN_SKEL_HEAD, headJoint);
             
             XnPoint3D pt_world, pt_screen;
             pt_world = headJoint.position;
@@ -369,11 +465,12 @@ void OpenGLHelper::drawSkeletonCommon()
             g_RightHandPositionHistory.SetTarget(pt_world, pt_screen);
         }
         
-        const char *pCSVHeader = "XN_SKEL_HEAD; XN_SKEL_NECK; XN_SKEL_LEFT_SHOULDER; XN_SKEL_LEFT_ELBOW; XN_SKEL_NECK; XN_SKEL_RIGHT_SHOULDER; XN_SKEL_RIGHT_ELBOW; XN_SKEL_TORSO; XN_SKEL_LEFT_HIP; XN_SKEL_LEFT_KNEE; XN_SKEL_RIGHT_HIP; XN_SKEL_LEFT_FOOT; XN_SKEL_RIGHT_KNEE; XN_SKEL_LEFT_HIP; XN_SKEL_RIGHT_FOOT; XN_SKEL_RIGHT_HAND; XN_SKEL_LEFT_HAND";
+        // the log keeps every joint whatever is drawn, so its columns stay the same
+        static const std::string csvHeader = skeleton::csvHeader(skeleton::FullBody);
         
         std::string fname = std::string("JointPositionData/") + std::to_string(aUsers[i]);
 
-        OutputData::ScopedFileStreamForAppend fs(fname, pCSVHeader);
+        OutputData::ScopedFileStreamForAppend fs(fname, csvHeader.c_str());
         ofstream &csv_file = fs.GetStream();
         
         if (g_bPrintID)
@@ -381,21 +478,16 @@ void OpenGLHelper::drawSkeletonCommon()
             XnPoint3D com;
             userGenerator.GetCoM(aUsers[i], com);
             depthGenerator.ConvertRealWorldToProjective(1, &com, &com);// I need to change with image generator
-            glVertex2f(com.X, com.Y);
             //float tmpCOM_x =com.X;
             //float tmpCOM_y =com.Y;
             
             // Calculate the distance from the qrcode to camera
             float dist = com.Z /1000.0f;
             sprintf(strLabel, "Distance :(%.1fm) ", dist);
-            glColor3f(1.f,1.f,1.f);
-            glRasterPos2i(5, 10);
-            glPrintString(GLUT_BITMAP_HELVETICA_18, strLabel, 0.75f);
+            glPrintString(5, 10, strLabel, 0.75f);
             
             /*sprintf(strLabel, "Hand speeds (L/R) :(%.1f/%.1f) ", g_LeftHandPositionHistory.Speed(), g_RightHandPositionHistory.Speed());
-            glColor3f(1.f,1.f,1.f);
-            glRasterPos2i(20, 130);
-            glPrintString(GLUT_BITMAP_HELVETICA_18, strLabel, 0.75f);
+            glPrintString(20, 130, strLabel, 0.75f);
             */
             
             xnOSMemSet(strLabel, 0, sizeof(strLabel));
@@ -423,36 +515,17 @@ void OpenGLHelper::drawSkeletonCommon()
             }
             
             
-            glColor4f(1-Colors[i%nColors][0], 1-Colors[i%nColors][1], 1-Colors[i%nColors][2], 1);
-            
-            glRasterPos2i(com.X, com.Y);
-            glPrintString(GLUT_BITMAP_HELVETICA_18, strLabel);
+            glPrintString(com.X, com.Y, strLabel);
             
             if (g_bDrawSkeleton && userGenerator.GetSkeletonCap().IsTracking(aUsers[i]))
             {
                 csv_file << "\r\n";
                 
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, 0, &csv_file);
-                
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, 0, &csv_file);
-                
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW, 0, &csv_file);
-                
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_FOOT, 0, &csv_file);
-                
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_FOOT, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, 0, &csv_file);
-                DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, 0, &csv_file, false);
+                int column = 0;
+                skeleton::forEachJoint(skeleton::FullBody, [&](const skeleton::Joint &joint) {
+                    bool addComma = ++column < skeleton::JointCount;
+                    DrawPoint(userGenerator, depthGenerator, aUsers[i], joint.id, 0, &csv_file, addComma);
+                });
 
             }
         }
@@ -461,7 +534,7 @@ void OpenGLHelper::drawSkeletonCommon()
     }
 }
 
-void OpenGLHelper::drawSkeletonInDepthView()
+void OpenGLHelper::drawSkeletonInDepthView(float viewWidth, float viewHeight)
 {
     XnUserID aUsers[3];
     XnUInt16 nUsers = 3;
@@ -475,98 +548,35 @@ void OpenGLHelper::drawSkeletonInDepthView()
     {
         if (g_bDrawSkeleton && userGenerator.GetSkeletonCap().IsTracking(aUsers[i]))
         {
-            glLineWidth(width);
-            glBegin(GL_LINES);
-            glColor4f(1-Colors[aUsers[i]%nColors][0], 1-Colors[aUsers[i]%nColors][1], 1-Colors[aUsers[i]%nColors][2], 1);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, XN_SKEL_NECK);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, XN_SKEL_LEFT_SHOULDER);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER, XN_SKEL_LEFT_ELBOW);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW, XN_SKEL_LEFT_HAND);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, XN_SKEL_RIGHT_SHOULDER);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER, XN_SKEL_RIGHT_ELBOW);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW, XN_SKEL_RIGHT_HAND);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER, XN_SKEL_TORSO);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER, XN_SKEL_TORSO);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO, XN_SKEL_LEFT_HIP);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, XN_SKEL_LEFT_KNEE);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE, XN_SKEL_LEFT_FOOT);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO, XN_SKEL_RIGHT_HIP);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP, XN_SKEL_RIGHT_KNEE);
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE, XN_SKEL_RIGHT_FOOT);
-            
-            DrawLimb(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, XN_SKEL_RIGHT_HIP);
-            glEnd();
-            
-            
-            glPointSize(10.0);
-            glBegin(GL_POINTS);
-            glColor3f(1.f, 0.f, 0.f);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_FOOT);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_FOOT);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND);
+            skeletonBatch.setLineWidth(width);
+            skeletonBatch.setColor(1-Colors[aUsers[i]%nColors][0], 1-Colors[aUsers[i]%nColors][1], 1-Colors[aUsers[i]%nColors][2]);
+            skeleton::forEachBone(g_SkeletonProfile, [&](const skeleton::Bone &bone) {
+                DrawLimb(userGenerator, depthGenerator, aUsers[i], bone.from, bone.to);
+            });
             
-            glEnd();
+            skeletonBatch.setPointSize(10.0);
+            skeletonBatch.setColor(1.f, 0.f, 0.f);
             
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, DRAW_POSITION);
+            skeleton::forEachJoint(g_SkeletonProfile, [&](const skeleton::Joint &joint) {
+                DrawJoint(userGenerator, depthGenerator, aUsers[i], joint.id);
+            });
             
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, DRAW_POSITION);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW, DRAW_POSITION);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_FOOT, DRAW_POSITION);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_FOOT, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, DRAW_POSITION);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, DRAW_POSITION);
-            
-            //Distance3D(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, XN_SKEL_RIGHT_HAND);
-            //Distance3D(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, XN_SKEL_LEFT_HAND);
+            skeleton::forEachJoint(g_SkeletonProfile, [&](const skeleton::Joint &joint) {
+                DrawPoint(userGenerator, depthGenerator, aUsers[i], joint.id, DRAW_POSITION);
+            });
             
             DrawCircle(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, 10, g_RightHandPositionHistory.Color());
             DrawCircle(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, 10, g_LeftHandPositionHistory.Color());
         }
         
     }
+    
+    // Everything of every user in one draw
+    skeletonBatch.draw(viewWidth, viewHeight);
 }
 
-void OpenGLHelper::drawSkeletonInRGBView()
+void OpenGLHelper::drawSkeletonInRGBView(float viewWidth, float viewHeight)
 {
-    glColor3f(1.f,1.f,1.f);
-
     bool EnableLeftHand = true;
     bool EnableRightHand = true;
     
@@ -581,66 +591,30 @@ void OpenGLHelper::drawSkeletonInRGBView()
     {
         if (g_bDrawSkeleton && userGenerator.GetSkeletonCap().IsTracking(aUsers[i]))
         {
-            glPointSize(10.0);
-            glBegin(GL_POINTS);
-            glColor3f(1.f, 0.f, 0.f);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK);
-            
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW);
+            skeletonBatch.setPointSize(10.0);
+            skeletonBatch.setColor(1.f, 0.f, 0.f);
             
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_FOOT);
+            skeleton::forEachJoint(g_SkeletonProfile, [&](const skeleton::Joint &joint) {
+                DrawJoint(userGenerator, depthGenerator, aUsers[i], joint.id);
+            });
             
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_FOOT);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND);
-            DrawJoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND);
-            
-            glEnd();
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, DRAW_NAME);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_SHOULDER, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_ELBOW, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_NECK, DRAW_NAME);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_SHOULDER, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_ELBOW, DRAW_NAME);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_TORSO, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_KNEE, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HIP, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_FOOT, DRAW_NAME);
-            
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_KNEE, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HIP, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_FOOT, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, DRAW_NAME);
-            DrawPoint(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, DRAW_NAME);
+            skeleton::forEachJoint(g_SkeletonProfile, [&](const skeleton::Joint &joint) {
+                DrawPoint(userGenerator, depthGenerator, aUsers[i], joint.id, DRAW_NAME);
+            });
             
             if (EnableRightHand) handtrajectory(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, true);
             if (EnableLeftHand) handtrajectory(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, true);
-            
-            //Distance3D(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, XN_SKEL_RIGHT_HAND);
-            //Distance3D(userGenerator, depthGenerator, aUsers[i], XN_SKEL_HEAD, XN_SKEL_LEFT_HAND);
+            drawPredictions(depthGenerator, aUsers[i]);
             
             DrawCircle(userGenerator, depthGenerator, aUsers[i], XN_SKEL_RIGHT_HAND, 10, g_RightHandPositionHistory.Color());
             DrawCircle(userGenerator, depthGenerator, aUsers[i], XN_SKEL_LEFT_HAND, 10, g_LeftHandPositionHistory.Color());
         }
         
     }
+    
+    if (g_bDrawSkeleton) drawForecastCones(depthGenerator);
+    
+    // Everything of every user in one draw, the cones blended over the rest
+    skeletonBatch.draw(viewWidth, viewHeight);
 }
 
@@ -0,0 +1,395 @@
+#include "skeleton_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const size_t InitialCapacity = 4096;    // vertices: a few users with every limb and trajectory
+    const size_t InitialInstances = 1024;   // joints, history points and hand markers; curve segments
+
+    struct MeshVertex
+    {
+        float x, y;
+    };
+
+    inline uint32_t packColor(float r, float g, float b, float a)
+    {
+        auto byte = [](float c) { return (uint32_t)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+        return byte(r) | byte(g) << 8 | byte(b) << 16 | byte(a) << 24;
+    }
+
+    inline uint32_t scaleAlpha(uint32_t color, float scale)
+    {
+        return (color & 0x00ffffffu) | (uint32_t)((color >> 24) * scale + 0.5f) << 24;
+    }
+
+    inline uint32_t mixColors(uint32_t c0, uint32_t c1, float t)
+    {
+        uint32_t mixed = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            float a = (c0 >> shift) & 0xff, b = (c1 >> shift) & 0xff;
+            mixed |= (uint32_t)(a + t * (b - a) + 0.5f) << shift;
+        }
+        return mixed;
+    }
+
+    /** Unit circle, computed once instead of every frame */
+    const float *unitCircle(int segments)
+    {
+        static std::vector<float> xy;
+        if (xy.empty())
+        {
+            for (int k = 0; k <= segments; ++k)
+            {
+                float angle = k * 6.28318530718f / segments;
+                xy.push_back(cosf(angle));
+                xy.push_back(sinf(angle));
+            }
+        }
+        return xy.data();
+    }
+}
+
+
+// SkeletonRenderer
+//
+void SkeletonRenderer::setColor(float r, float g, float b, float a)
+{
+    color_ = packColor(r, g, b, a);
+}
+
+void SkeletonRenderer::addLine(float x0, float y0, float x1, float y1)
+{
+    addQuad(x0, y0, color_, x1, y1, color_, lineWidth_);
+}
+
+void SkeletonRenderer::addQuad(float x0, float y0, uint32_t color0, float x1, float y1, uint32_t color1, float width)
+{
+    float dx = x1 - x0, dy = y1 - y0, length = sqrtf(dx * dx + dy * dy);
+    if (length < 1e-3f) return;
+
+    // quad 'width' wide, centered on the line
+    float nx = -dy / length * 0.5f * width, ny = dx / length * 0.5f * width;
+    const Vertex a = { x0 + nx, y0 + ny, color0 }, b = { x0 - nx, y0 - ny, color0 };
+    const Vertex c = { x1 - nx, y1 - ny, color1 }, d = { x1 + nx, y1 + ny, color1 };
+    vertices_.insert(vertices_.end(), { a, b, c, a, c, d });
+}
+
+void SkeletonRenderer::addPoint(float x, float y)
+{
+    points_.push_back({ x, y, pointSize_, color_ });
+}
+
+void SkeletonRenderer::addTriangle(float x0, float y0, float x1, float y1, float x2, float y2)
+{
+    const Vertex a = { x0, y0, color_ }, b = { x1, y1, color_ }, c = { x2, y2, color_ };
+    vertices_.insert(vertices_.end(), { a, b, c });
+}
+
+void SkeletonRenderer::addDisc(float x, float y, float radius)
+{
+    discs_.push_back({ x, y, radius, color_ });
+}
+
+void SkeletonRenderer::addBezier(const float *xy)
+{
+    Curve curve;
+    std::copy(xy, xy + 8, &curve.p[0][0]);
+    curve.width = lineWidth_;
+    curve.color0 = curve.color1 = color_;
+    curves_.push_back(curve);
+}
+
+void SkeletonRenderer::addPolyline(const float *xy, int count, float endAlpha)
+{
+    // Catmull-Rom through the points, a Bezier per segment
+    auto point = [&](int k) { k = std::min(std::max(k, 0), count - 1); return xy + 2 * k; };
+    for (int k = 0; k + 1 < count; ++k)
+    {
+        const float *p0 = point(k - 1), *p1 = point(k), *p2 = point(k + 1), *p3 = point(k + 2);
+
+        Curve curve;
+        for (int c = 0; c < 2; ++c)
+        {
+            curve.p[0][c] = p1[c];
+            curve.p[1][c] = p1[c] + (p2[c] - p0[c]) / 6.0f;
+            curve.p[2][c] = p2[c] - (p3[c] - p1[c]) / 6.0f;
+            curve.p[3][c] = p2[c];
+        }
+        curve.width = lineWidth_;
+        curve.color0 = scaleAlpha(color_, 1.0f + (endAlpha - 1.0f) * k / (count - 1));
+        curve.color1 = scaleAlpha(color_, 1.0f + (endAlpha - 1.0f) * (k + 1) / (count - 1));
+        curves_.push_back(curve);
+    }
+}
+
+void SkeletonRenderer::draw(float width, float height)
+{
+    bool bReady = (!vertices_.empty() || !points_.empty() || !discs_.empty() || !curves_.empty()) && setStates();
+    if (bReady && !bInstanced_) expandInstances();
+
+    lastVertexCount_ = (int)vertices_.size();
+    lastInstanceCount_ = (int)(points_.size() + discs_.size() + curves_.size());
+    if (!bReady)
+    {
+        vertices_.clear();
+        points_.clear();
+        discs_.clear();
+        curves_.clear();
+        return;
+    }
+
+    float projection[16];
+    gfx::orthoProjection(width, height, projection);
+
+    gpuTimer_.begin();
+    if (vao_) glBindVertexArray(vao_);
+
+    // translucent colors (the forecast cones) blend over what came before; alpha
+    // accumulates as coverage, so a transparent layer ends up premultiplied
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Write the frame into the next region of the ring; it grows when needed
+    Vertex *dst = vertices_.empty()? nullptr : vb_->map<Vertex>((uint32_t)vertices_.size());
+    if (dst)
+    {
+        std::copy(vertices_.begin(), vertices_.end(), dst);
+        const size_t offset = vb_->unmap();
+
+        program_->bind();
+        glUniformMatrix4fv(projectionLoc_, 1, GL_FALSE, projection);
+
+        vb_->bind();
+        glEnableVertexAttribArray(positionLoc_);
+        glEnableVertexAttribArray(colorLoc_);
+        glVertexAttribPointer(positionLoc_, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(offset + offsetof(Vertex, x)));
+        glVertexAttribPointer(colorLoc_, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)(offset + offsetof(Vertex, color)));
+
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices_.size());
+        vb_->fence();
+
+        glDisableVertexAttribArray(positionLoc_);
+        glDisableVertexAttribArray(colorLoc_);
+    }
+
+    // The curves over the triangles, anti-aliased
+    Curve *curves = curves_.empty()? nullptr : curveVb_->map<Curve>((uint32_t)curves_.size());
+    if (curves)
+    {
+        std::copy(curves_.begin(), curves_.end(), curves);
+        const size_t offset = curveVb_->unmap();
+
+        curveProgram_->bind();
+        glUniformMatrix4fv(curveProjectionLoc_, 1, GL_FALSE, projection);
+
+        drawCurves(offset);
+        curveVb_->fence();
+    }
+
+    // The markers on top, points then discs so the hand markers cover the trajectory
+    size_t markers = points_.size() + discs_.size();
+    Instance *instances = markers? instanceVb_->map<Instance>((uint32_t)markers) : nullptr;
+    if (instances)
+    {
+        instances = std::copy(points_.begin(), points_.end(), instances);
+        std::copy(discs_.begin(), discs_.end(), instances);
+        const size_t offset = instanceVb_->unmap();
+
+        markerProgram_->bind();
+        glUniformMatrix4fv(markerProjectionLoc_, 1, GL_FALSE, projection);
+
+        drawInstances(offset, 0, SquareVertices, (GLsizei)points_.size());
+        drawInstances(offset + points_.size() * sizeof(Instance), SquareVertices, 3 * DiscSegments, (GLsizei)discs_.size());
+        instanceVb_->fence();
+    }
+
+    glDisable(GL_BLEND);
+    if (vao_) glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    gpuTimer_.end();
+
+    vertices_.clear();
+    points_.clear();
+    discs_.clear();
+    curves_.clear();
+}
+
+void SkeletonRenderer::drawInstances(size_t offset, GLint first, GLsizei count, GLsizei instances)
+{
+    if (!instances) return;
+
+    meshVb_->bind();
+    glEnableVertexAttribArray(meshLoc_);
+    glVertexAttribPointer(meshLoc_, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void *)0);
+
+    instanceVb_->bind();
+    glEnableVertexAttribArray(instanceLoc_);
+    glEnableVertexAttribArray(instanceColorLoc_);
+    glVertexAttribPointer(instanceLoc_, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)(offset + offsetof(Instance, x)));
+    glVertexAttribPointer(instanceColorLoc_, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void *)(offset + offsetof(Instance, color)));
+    glVertexAttribDivisor(instanceLoc_, 1);
+    glVertexAttribDivisor(instanceColorLoc_, 1);
+
+    glDrawArraysInstanced(GL_TRIANGLES, first, count, instances);
+
+    glVertexAttribDivisor(instanceLoc_, 0);
+    glVertexAttribDivisor(instanceColorLoc_, 0);
+    glDisableVertexAttribArray(meshLoc_);
+    glDisableVertexAttribArray(instanceLoc_);
+    glDisableVertexAttribArray(instanceColorLoc_);
+}
+
+void SkeletonRenderer::drawCurves(size_t offset)
+{
+    meshVb_->bind();
+    glEnableVertexAttribArray(curveMeshLoc_);
+    glVertexAttribPointer(curveMeshLoc_, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void *)0);
+
+    struct Attribute { GLint loc; GLint size; GLenum type; size_t at; };
+    const Attribute attributes[] = {
+        { controlLoc_[0], 4, GL_FLOAT, offsetof(Curve, p) },
+        { controlLoc_[1], 4, GL_FLOAT, offsetof(Curve, p) + 4 * sizeof(float) },
+        { widthLoc_, 1, GL_FLOAT, offsetof(Curve, width) },
+        { color0Loc_, 4, GL_UNSIGNED_BYTE, offsetof(Curve, color0) },
+        { color1Loc_, 4, GL_UNSIGNED_BYTE, offsetof(Curve, color1) }
+    };
+
+    curveVb_->bind();
+    for (auto &a : attributes)
+    {
+        glEnableVertexAttribArray(a.loc);
+        glVertexAttribPointer(a.loc, a.size, a.type, a.type == GL_UNSIGNED_BYTE, sizeof(Curve), (void *)(offset + a.at));
+        glVertexAttribDivisor(a.loc, 1);
+    }
+
+    glDrawArraysInstanced(GL_TRIANGLES, SquareVertices + 3 * DiscSegments, 6 * CurveSegments, (GLsizei)curves_.size());
+
+    for (auto &a : attributes)
+    {
+        glVertexAttribDivisor(a.loc, 0);
+        glDisableVertexAttribArray(a.loc);
+    }
+    glDisableVertexAttribArray(curveMeshLoc_);
+}
+
+void SkeletonRenderer::expandInstances()
+{
+    // curves first, as they are drawn under the markers
+    for (auto &curve : curves_)
+    {
+        float previous[2] = { curve.p[0][0], curve.p[0][1] };
+        for (int k = 1; k <= CurveSegments; ++k)
+        {
+            float t = k / (float)CurveSegments, s = 1.0f - t;
+            float b[4] = { s * s * s, 3 * s * s * t, 3 * s * t * t, t * t * t };
+            float x = b[0] * curve.p[0][0] + b[1] * curve.p[1][0] + b[2] * curve.p[2][0] + b[3] * curve.p[3][0];
+            float y = b[0] * curve.p[0][1] + b[1] * curve.p[1][1] + b[2] * curve.p[2][1] + b[3] * curve.p[3][1];
+            addQuad(previous[0], previous[1], mixColors(curve.color0, curve.color1, (k - 1) / (float)CurveSegments),
+                    x, y, mixColors(curve.color0, curve.color1, t), curve.width);
+            previous[0] = x;
+            previous[1] = y;
+        }
+    }
+
+    for (auto &point : points_)
+    {
+        float h = 0.5f * point.size;
+        const Vertex a = { point.x - h, point.y - h, point.color }, b = { point.x + h, point.y - h, point.color };
+        const Vertex c = { point.x + h, point.y + h, point.color }, d = { point.x - h, point.y + h, point.color };
+        vertices_.insert(vertices_.end(), { a, b, c, a, c, d });
+    }
+
+    const float *circle = unitCircle(DiscSegments);
+    for (auto &disc : discs_)
+    {
+        const Vertex center = { disc.x, disc.y, disc.color };
+        for (int k = 0; k < DiscSegments; ++k)
+        {
+            const Vertex a = { disc.x + disc.size * circle[2 * k], disc.y + disc.size * circle[2 * k + 1], disc.color };
+            const Vertex b = { disc.x + disc.size * circle[2 * k + 2], disc.y + disc.size * circle[2 * k + 3], disc.color };
+            vertices_.insert(vertices_.end(), { center, a, b });
+        }
+    }
+
+    points_.clear();
+    discs_.clear();
+    curves_.clear();
+}
+
+bool SkeletonRenderer::setStates()
+{
+    if (bError_) return false;
+
+    if (!program_)
+    {
+        program_ = std::make_unique<gfx::Program>();
+        if (!program_->init("data/skeleton"))
+        {
+            bError_ = true;
+            return false;
+        }
+        projectionLoc_ = program_->uniformLocation("projection");
+        positionLoc_ = glGetAttribLocation(program_->platformHandle(), "position");
+        colorLoc_ = glGetAttribLocation(program_->platformHandle(), "color");
+
+        vb_ = std::make_unique<gfx::StreamingBuffer>();
+        vb_->init(InitialCapacity * sizeof(Vertex));
+
+        // core profile draws need a vertex array object, and have instancing
+        if (!window::isLegacyOpenGL())
+        {
+            glGenVertexArrays(1, &vao_);
+
+            markerProgram_ = std::make_unique<gfx::Program>();
+            curveProgram_ = std::make_unique<gfx::Program>();
+            bInstanced_ = markerProgram_->init("data/marker") && curveProgram_->init("data/curve");
+        }
+        if (bInstanced_)
+        {
+            markerProjectionLoc_ = markerProgram_->uniformLocation("projection");
+            meshLoc_ = glGetAttribLocation(markerProgram_->platformHandle(), "position");
+            instanceLoc_ = glGetAttribLocation(markerProgram_->platformHandle(), "instance");
+            instanceColorLoc_ = glGetAttribLocation(markerProgram_->platformHandle(), "color");
+
+            curveProjectionLoc_ = curveProgram_->uniformLocation("projection");
+            curveMeshLoc_ = glGetAttribLocation(curveProgram_->platformHandle(), "position");
+            controlLoc_[0] = glGetAttribLocation(curveProgram_->platformHandle(), "p01");
+            controlLoc_[1] = glGetAttribLocation(curveProgram_->platformHandle(), "p23");
+            widthLoc_ = glGetAttribLocation(curveProgram_->platformHandle(), "width");
+            color0Loc_ = glGetAttribLocation(curveProgram_->platformHandle(), "color0");
+            color1Loc_ = glGetAttribLocation(curveProgram_->platformHandle(), "color1");
+
+            // unit square, the unit disc as a fan of triangles, then a strip of
+            // (t, side) quads along a curve
+            std::vector<MeshVertex> mesh = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+            const float *circle = unitCircle(DiscSegments);
+            for (int k = 0; k < DiscSegments; ++k)
+            {
+                mesh.insert(mesh.end(), { { 0.0f, 0.0f }, { circle[2 * k], circle[2 * k + 1] }, { circle[2 * k + 2], circle[2 * k + 3] } });
+            }
+            for (int k = 0; k < CurveSegments; ++k)
+            {
+                float t0 = k / (float)CurveSegments, t1 = (k + 1) / (float)CurveSegments;
+                mesh.insert(mesh.end(), { { t0, -1.0f }, { t0, 1.0f }, { t1, 1.0f }, { t0, -1.0f }, { t1, 1.0f }, { t1, -1.0f } });
+            }
+            meshVb_ = std::make_unique<gfx::VertexBuffer>();
+            meshVb_->init((uint32_t)mesh.size(), gfx::BufferUsage::StaticDraw, mesh.data());
+
+            instanceVb_ = std::make_unique<gfx::StreamingBuffer>();
+            instanceVb_->init(InitialInstances * sizeof(Instance));
+
+            curveVb_ = std::make_unique<gfx::StreamingBuffer>();
+            curveVb_->init(InitialInstances * sizeof(Curve));
+        }
+        else
+        {
+            markerProgram_.reset();
+            curveProgram_.reset();
+        }
+    }
+    return true;
+}
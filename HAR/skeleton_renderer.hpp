@@ -0,0 +1,117 @@
+#ifndef skeleton_renderer_hpp
+#define skeleton_renderer_hpp
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "subsys.hpp"
+
+// Skeleton renderer
+//
+// Collects the limbs, joints, hand markers, trajectories and forecasts of
+// every user for one view into a single vertex array, then draws it with one
+// gfx::StreamingBuffer upload and one draw call, in the order added.
+// The add calls follow the immediate mode calls they replace (color, line
+// width and point size are current state), but everything is emitted as
+// triangles in the view's coordinates: wide lines and point sizes do not
+// exist in core profile GL, and neither does the matrix stack, so the view
+// size is passed to draw().
+//
+// Points and discs (joints, history points, hand markers) are instances
+// instead: a position, size and color each, drawn over the triangles with one
+// instanced draw per mesh from a unit square and a unit disc kept in a static
+// buffer. Curves (trajectories, predicted paths, approach curves) are
+// instances too: the four control points of a cubic Bezier, a width and a
+// color at each end. The vertex shader tessellates a strip along each one and
+// widens it across the curve in pixels, feathered a pixel at the edges, so a
+// curve costs the same on the CPU however finely it is drawn. Legacy contexts
+// expand all instances into triangles on the CPU. The GPU time of draw() is
+// measured with a gfx::GpuTimer.
+//
+class SkeletonRenderer
+{
+public:
+    struct Vertex
+    {
+        float x, y;
+        uint32_t color;                 // RGBA8
+    };
+
+    struct Instance
+    {
+        float x, y;
+        float size;                     // square side or disc radius
+        uint32_t color;
+    };
+
+    struct Curve
+    {
+        float p[4][2];                  // Bezier control points
+        float width;
+        uint32_t color0, color1;        // at p[0] and p[3]
+    };
+
+    void setColor(float r, float g, float b, float a = 1.0f);
+    void setLineWidth(float width) { lineWidth_ = width; }
+    void setPointSize(float size) { pointSize_ = size; }
+
+    void addLine(float x0, float y0, float x1, float y1);
+    void addPoint(float x, float y);    // square, like a GL point
+    void addDisc(float x, float y, float radius);
+    void addTriangle(float x0, float y0, float x1, float y1, float x2, float y2);
+
+    /** Cubic Bezier from p[0] to p[3], 'xy' holding the four x, y pairs */
+    void addBezier(const float *xy);
+
+    /** Smooth curve through 'count' x, y pairs, its alpha scaled by 'endAlpha' at the last one */
+    void addPolyline(const float *xy, int count, float endAlpha = 1.0f);
+
+    /** Builds the programs and buffers now, at startup, instead of at the first draw */
+    bool prepare() { return setStates(); }
+
+    /** Draw everything added since the last draw, in a view of 'width' x 'height' with the origin at the bottom left */
+    void draw(float width, float height);
+
+    int lastVertexCount() const { return lastVertexCount_; }
+    int lastInstanceCount() const { return lastInstanceCount_; }     // markers and curve segments
+    double gpuMs() const { return gpuTimer_.averageMs(); }
+
+private:
+    bool setStates();
+    void drawInstances(size_t offset, GLint first, GLsizei count, GLsizei instances);
+    void drawCurves(size_t offset);
+    void expandInstances();
+    void addQuad(float x0, float y0, uint32_t color0, float x1, float y1, uint32_t color1, float width);
+
+    static const int DiscSegments = 16;
+    static const int CurveSegments = 16;
+    static const int SquareVertices = 6;        // then the disc, then the curve strip, in meshVb_
+
+    std::vector<Vertex> vertices_;
+    std::vector<Instance> points_, discs_;
+    std::vector<Curve> curves_;
+    uint32_t color_ = 0xffffffff;
+    float lineWidth_ = 1.0f;
+    float pointSize_ = 1.0f;
+    int lastVertexCount_ = 0;
+    int lastInstanceCount_ = 0;
+
+    bool bError_ = false;
+    std::unique_ptr<gfx::StreamingBuffer> vb_;
+    std::unique_ptr<gfx::Program> program_;
+    GLuint vao_ = 0;
+    GLint projectionLoc_ = -1, positionLoc_ = -1, colorLoc_ = -1;
+
+    bool bInstanced_ = false;
+    std::unique_ptr<gfx::VertexBuffer> meshVb_;
+    std::unique_ptr<gfx::StreamingBuffer> instanceVb_;
+    std::unique_ptr<gfx::Program> markerProgram_;
+    GLint markerProjectionLoc_ = -1, meshLoc_ = -1, instanceLoc_ = -1, instanceColorLoc_ = -1;
+    std::unique_ptr<gfx::StreamingBuffer> curveVb_;
+    std::unique_ptr<gfx::Program> curveProgram_;
+    GLint curveProjectionLoc_ = -1, curveMeshLoc_ = -1, controlLoc_[2] = { -1, -1 }, widthLoc_ = -1, color0Loc_ = -1, color1Loc_ = -1;
+    gfx::GpuTimer gpuTimer_;
+};
+
+#endif /* skeleton_renderer_hpp */
@@ -0,0 +1,180 @@
+#ifndef skeleton_topology_hpp
+#define skeleton_topology_hpp
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <XnOpenNI.h>
+
+// Skeleton topology
+//
+// The joints the tracker reports, the bones between them and what they are
+// called, as compile time tables. Drawing, the joint CSV and the features
+// loop over these instead of listing joints by hand, so a joint is drawn,
+// logged and named exactly once, in table order. The checks at the bottom
+// reject a table with a joint or bone listed twice, or a bone to a joint
+// that is not in it.
+//
+// A Profile selects part of the table (the upper body when the legs are out
+// of view, for instance); bones are in a profile when both of their joints are.
+//
+namespace skeleton
+{
+    struct Joint
+    {
+        XnSkeletonJoint id;
+        const char *name;       // feature and log column prefix
+        const char *label;      // drawn next to the joint
+        const char *column;     // joint position CSV header
+    };
+
+    struct Bone
+    {
+        XnSkeletonJoint from, to;
+    };
+
+    constexpr Joint Joints[] = {
+        { XN_SKEL_HEAD, "Head", "head", "XN_SKEL_HEAD" },
+        { XN_SKEL_NECK, "Neck", "neck", "XN_SKEL_NECK" },
+        { XN_SKEL_TORSO, "Torso", "torso", "XN_SKEL_TORSO" },
+        { XN_SKEL_LEFT_SHOULDER, "LeftShoulder", "left shoulder", "XN_SKEL_LEFT_SHOULDER" },
+        { XN_SKEL_LEFT_ELBOW, "LeftElbow", "left elbow", "XN_SKEL_LEFT_ELBOW" },
+        { XN_SKEL_LEFT_HAND, "LeftHand", "left hand", "XN_SKEL_LEFT_HAND" },
+        { XN_SKEL_RIGHT_SHOULDER, "RightShoulder", "right shoulder", "XN_SKEL_RIGHT_SHOULDER" },
+        { XN_SKEL_RIGHT_ELBOW, "RightElbow", "right elbow", "XN_SKEL_RIGHT_ELBOW" },
+        { XN_SKEL_RIGHT_HAND, "RightHand", "right hand", "XN_SKEL_RIGHT_HAND" },
+        { XN_SKEL_LEFT_HIP, "LeftHip", "left hip", "XN_SKEL_LEFT_HIP" },
+        { XN_SKEL_LEFT_KNEE, "LeftKnee", "left knee", "XN_SKEL_LEFT_KNEE" },
+        { XN_SKEL_LEFT_FOOT, "LeftFoot", "left foot", "XN_SKEL_LEFT_FOOT" },
+        { XN_SKEL_RIGHT_HIP, "RightHip", "right hip", "XN_SKEL_RIGHT_HIP" },
+        { XN_SKEL_RIGHT_KNEE, "RightKnee", "right knee", "XN_SKEL_RIGHT_KNEE" },
+        { XN_SKEL_RIGHT_FOOT, "RightFoot", "right foot", "XN_SKEL_RIGHT_FOOT" }
+    };
+
+    constexpr Bone Bones[] = {
+        { XN_SKEL_HEAD, XN_SKEL_NECK },
+        { XN_SKEL_NECK, XN_SKEL_LEFT_SHOULDER },
+        { XN_SKEL_LEFT_SHOULDER, XN_SKEL_LEFT_ELBOW },
+        { XN_SKEL_LEFT_ELBOW, XN_SKEL_LEFT_HAND },
+        { XN_SKEL_NECK, XN_SKEL_RIGHT_SHOULDER },
+        { XN_SKEL_RIGHT_SHOULDER, XN_SKEL_RIGHT_ELBOW },
+        { XN_SKEL_RIGHT_ELBOW, XN_SKEL_RIGHT_HAND },
+        { XN_SKEL_LEFT_SHOULDER, XN_SKEL_TORSO },
+        { XN_SKEL_RIGHT_SHOULDER, XN_SKEL_TORSO },
+        { XN_SKEL_TORSO, XN_SKEL_LEFT_HIP },
+        { XN_SKEL_LEFT_HIP, XN_SKEL_LEFT_KNEE },
+        { XN_SKEL_LEFT_KNEE, XN_SKEL_LEFT_FOOT },
+        { XN_SKEL_TORSO, XN_SKEL_RIGHT_HIP },
+        { XN_SKEL_RIGHT_HIP, XN_SKEL_RIGHT_KNEE },
+        { XN_SKEL_RIGHT_KNEE, XN_SKEL_RIGHT_FOOT },
+        { XN_SKEL_LEFT_HIP, XN_SKEL_RIGHT_HIP }
+    };
+
+    constexpr int JointCount = sizeof(Joints) / sizeof(Joints[0]);
+    constexpr int BoneCount = sizeof(Bones) / sizeof(Bones[0]);
+
+    /** Position of the joint in Joints, -1 if it is not there */
+    constexpr int indexOf(XnSkeletonJoint id)
+    {
+        for (int j = 0; j < JointCount; ++j)
+        {
+            if (Joints[j].id == id) return j;
+        }
+        return -1;
+    }
+
+    constexpr uint32_t bit(XnSkeletonJoint id) { return 1u << indexOf(id); }
+
+
+    // Profiles
+    //
+    enum Profile { FullBody, UpperBody, ProfileCount };
+
+    /** Joints of the profile, one bit per entry of Joints */
+    constexpr uint32_t jointMask(Profile profile)
+    {
+        return profile == UpperBody?
+            bit(XN_SKEL_HEAD) | bit(XN_SKEL_NECK) | bit(XN_SKEL_TORSO) |
+            bit(XN_SKEL_LEFT_SHOULDER) | bit(XN_SKEL_LEFT_ELBOW) | bit(XN_SKEL_LEFT_HAND) |
+            bit(XN_SKEL_RIGHT_SHOULDER) | bit(XN_SKEL_RIGHT_ELBOW) | bit(XN_SKEL_RIGHT_HAND)
+            : (1u << JointCount) - 1u;
+    }
+
+    constexpr bool hasJoint(Profile profile, int j) { return (jointMask(profile) >> j & 1u) != 0; }
+
+    constexpr bool hasBone(Profile profile, int b)
+    {
+        return hasJoint(profile, indexOf(Bones[b].from)) && hasJoint(profile, indexOf(Bones[b].to));
+    }
+
+    namespace detail
+    {
+        template <typename F, std::size_t... I>
+        inline void unroll(F &&f, std::index_sequence<I...>)
+        {
+            (f(std::integral_constant<int, (int)I>()), ...);
+        }
+    }
+
+    /** Calls f(joint) for every joint of the profile, in table order; the loop is unrolled at compile time */
+    template <typename F>
+    inline void forEachJoint(Profile profile, F &&f)
+    {
+        detail::unroll([&](auto j) { if (hasJoint(profile, j)) f(Joints[j]); }, std::make_index_sequence<JointCount>());
+    }
+
+    /** Calls f(bone) for every bone of the profile */
+    template <typename F>
+    inline void forEachBone(Profile profile, F &&f)
+    {
+        detail::unroll([&](auto b) { if (hasBone(profile, b)) f(Bones[b]); }, std::make_index_sequence<BoneCount>());
+    }
+
+    /** Joint position CSV header: the columns of the profile, separated by "; " */
+    inline std::string csvHeader(Profile profile)
+    {
+        std::string header;
+        forEachJoint(profile, [&](const Joint &joint) {
+            if (!header.empty()) header += "; ";
+            header += joint.column;
+        });
+        return header;
+    }
+
+
+    // Checks
+    //
+    namespace detail
+    {
+        constexpr bool uniqueJoints()
+        {
+            for (int j = 0; j < JointCount; ++j)
+            {
+                if (indexOf(Joints[j].id) != j) return false;
+            }
+            return true;
+        }
+
+        constexpr bool validBones()
+        {
+            for (int b = 0; b < BoneCount; ++b)
+            {
+                if (indexOf(Bones[b].from) < 0 || indexOf(Bones[b].to) < 0 || Bones[b].from == Bones[b].to) return false;
+                for (int c = 0; c < b; ++c)
+                {
+                    bool bSame = Bones[c].from == Bones[b].from && Bones[c].to == Bones[b].to;
+                    bool bReversed = Bones[c].from == Bones[b].to && Bones[c].to == Bones[b].from;
+                    if (bSame || bReversed) return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    static_assert(JointCount <= 32, "joint masks are 32 bits");
+    static_assert(detail::uniqueJoints(), "a joint is listed twice");
+    static_assert(detail::validBones(), "a bone is listed twice or ends at a joint not in the table");
+}
+
+#endif /* skeleton_topology_hpp */
@@ -8,6 +8,7 @@ struct StatesInfo
 {
     virtual unsigned int numStates() = 0;
     virtual bool isStateActive(int state) = 0;
+    virtual const char *stateName(int /*state*/) { return "State"; }
 };
 
 
@@ -1,14 +1,25 @@
 #include "trajectory.hpp"
 #include "subsys.hpp"
 
-void History::StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen)
+void History::StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen, int quality)
 {
     if (--m_curr_pos < 0) m_curr_pos = m_max_size - 1;
     m_records [m_curr_pos].value_world = pt_world;
     m_records [m_curr_pos].value_screen = pt_screen;
-    m_records [m_curr_pos].time = window::getTime();
+    m_records [m_curr_pos].has_velocity = false;
+    m_records [m_curr_pos].quality = quality;
+    m_records [m_curr_pos].time = (int)(window::getTime() * 1000.0);
     
     if (++m_size > m_max_size) m_size = m_max_size;
 }
 
+void History::StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen,
+                          const XnVector3D &velocity_world, const XnVector3D &velocity_screen, int quality)
+{
+    StoreValue (pt_world, pt_screen, quality);
+    m_records [m_curr_pos].velocity_world = velocity_world;
+    m_records [m_curr_pos].velocity_screen = velocity_screen;
+    m_records [m_curr_pos].has_velocity = true;
+}
+
 
@@ -28,10 +28,15 @@ struct History {
     
     int Size() { return m_size; }
     
-    void StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen);
+    void StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen, int quality = 0);
+    void StoreValue (const XnPoint3D &pt_world, const XnPoint3D &pt_screen,
+                     const XnVector3D &velocity_world, const XnVector3D &velocity_screen, int quality = 0); // filtered sample
+    
+    int GetQuality (int index) { return m_records [(m_curr_pos + index) % m_max_size].quality; } // GapFiller::Quality
     
     XnPoint3D GetCurrentWorldPosition() { return m_records[m_curr_pos].value_world; } // in millimeters
     XnV3DVector GetCurrentScreenPosition() { return m_records[m_curr_pos].value_screen; } // in pixels
+    XnV3DVector GetCurrentWorldVelocity() { return m_records[m_curr_pos].velocity_world; } // in millimeters per second, if stored
     
     XnPoint3D GetTargetWorldPosition() { return m_target_world; } // in millimeters
     XnV3DVector GetTargetScreenPosition() { return m_target_screen; } // in pixels
@@ -48,7 +53,7 @@ struct History {
     {
         if (index < 0 || index > m_size) return false;
         
-        pt = m_records [(m_curr_pos + index) % m_max_size].value_screen;
+        pt = m_records [(m_curr_pos + index) % m_max_size].value_world;
         return true;
     }
     
@@ -72,14 +77,19 @@ struct History {
     
     float Speed() // in pixels per second
     {
-        if (m_size < 2) return 0.0f;
+        if (m_size < 1) return 0.0f;
         
         Record &last = m_records[m_curr_pos];
+        if (last.has_velocity) return XnV3DVector(last.velocity_screen).Magnitude();
+        if (m_size < 2) return 0.0f;
+        
         Record &prev = m_records[(m_curr_pos + 1) % m_max_size];
         
         XnV3DVector lastV = last.value_screen;
         XnV3DVector prevV = prev.value_screen;
         
+        if (last.time <= prev.time) return 0.0f;
+        
         return (lastV - prevV).Magnitude() / ((last.time - prev.time) * 0.001f);
     }
     
@@ -148,6 +158,33 @@ struct History {
         }
     }
     
+    void GetWorldPointsNewerThanTime(int timeMilliSec, std::vector<XnPoint3D> &points)
+    {
+        int count = Size();
+        for (int index = 0; index < count; ++index)
+        {
+            Record &rec = m_records [(m_curr_pos + index) % m_max_size];
+            if (rec.time >= timeMilliSec)
+            {
+                points.push_back(rec.value_world);
+            }
+        }
+    }
+    
+    void GetWorldRecordsNewerThanTime(int timeMilliSec, std::vector<XnPoint3D> &points, std::vector<int> &times)
+    {
+        int count = Size();
+        for (int index = 0; index < count; ++index)
+        {
+            Record &rec = m_records [(m_curr_pos + index) % m_max_size];
+            if (rec.time >= timeMilliSec)
+            {
+                points.push_back(rec.value_world);
+                times.push_back(rec.time);
+            }
+        }
+    }
+    
 private:
     const int m_max_size;
     
@@ -155,6 +192,10 @@ private:
     {
         XnPoint3D value_world; // world position in millimeters
         XnPoint3D value_screen;// screen position in pixels
+        XnVector3D velocity_world; // millimeters per second
+        XnVector3D velocity_screen;// pixels per second
+        bool     has_velocity;
+        int      quality;  // GapFiller::Quality: 0 measured, else how the sample was filled
         int      time; //milliseconds
     };
     std::vector<Record> m_records;
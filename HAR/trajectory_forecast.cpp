@@ -0,0 +1,311 @@
+#include "trajectory_forecast.hpp"
+#include "subsys.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    const int MinFitPoints = 5;
+    const int SimulationBlock = 256;    // particles per parallel task
+    const int ParticleStep = 64;        // granularity of the adaptive particle count
+
+    /** Solve the 3x3 system m x = b by Cramer's rule. False if singular. */
+    bool solve3(const double m[3][3], const double b[3], double x[3])
+    {
+        auto det = [](const double a[3][3]) {
+            return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+                 - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+                 + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        };
+        double d = det(m);
+        if (std::fabs(d) < 1e-12) return false;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            double mc[3][3];
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int k = 0; k < 3; ++k) mc[r][k] = k == c? b[r] : m[r][k];
+            }
+            x[c] = det(mc) / d;
+        }
+        return true;
+    }
+}
+
+
+// TrajectoryForecaster::Rng
+//
+uint64_t TrajectoryForecaster::Rng::next()
+{
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+float TrajectoryForecaster::Rng::normal()
+{
+    // Sum of four 16-bit uniforms (Irwin-Hall), rescaled to unit variance: one draw, no
+    // transcendentals, tails cut at 3.5 sigma which the cones never reach anyway
+    uint64_t r = next();
+    uint32_t sum = (uint32_t)(r & 0xffff) + (uint32_t)((r >> 16) & 0xffff) + (uint32_t)((r >> 32) & 0xffff) + (uint32_t)(r >> 48);
+    return ((float)sum * (1.0f / 65536.0f) - 2.0f) * 1.7320508f;
+}
+
+
+// TrajectoryForecaster
+//
+TrajectoryForecaster::TrajectoryForecaster()
+: positions_((size_t)HandCount * (Steps + 1) * 3 * MaxParticles, 0.0f)
+{
+    int threads = (int)std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+
+    rngs_.resize(threads);
+    scratch_.resize(threads);
+    for (int w = 0; w < threads; ++w)
+    {
+        rngs_[w].state = 0x5eed0000ull + w * 0x1000193ull;
+        scratch_[w].resize(MaxParticles);
+    }
+
+    // this thread is worker 0
+    for (int w = 1; w < threads; ++w)
+    {
+        workers_.emplace_back(&TrajectoryForecaster::workerLoop, this, w);
+    }
+}
+
+TrajectoryForecaster::~TrajectoryForecaster()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bQuit_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) worker.join();
+}
+
+void TrajectoryForecaster::update(History &leftHand, History &rightHand)
+{
+    History *histories[HandCount] = { &leftHand, &rightHand };
+
+    bool bChanged = false;
+    for (int h = 0; h < HandCount; ++h)
+    {
+        int newest = lastTime_[h];
+        bActive_[h] = fit(*histories[h], h);
+        if (!bActive_[h])
+        {
+            cones_[h].bValid = false;
+            continue;
+        }
+        bChanged = bChanged || lastTime_[h] != newest;
+    }
+    if (!bChanged) return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Particles, in blocks
+    const int blocks = (particles_ + SimulationBlock - 1) / SimulationBlock;
+    parallelFor(blocks, [this](int worker, int block) {
+        simulate(worker, block * SimulationBlock, std::min(particles_, (block + 1) * SimulationBlock));
+    });
+
+    // Percentiles, one task per hand and step
+    parallelFor(HandCount * Steps, [this](int worker, int task) {
+        percentiles(worker, task);
+    });
+
+    for (int h = 0; h < HandCount; ++h)
+    {
+        Cone &cone = cones_[h];
+        cone.bValid = bActive_[h];
+        cone.center[0].X = kinematics_[h].p[0];
+        cone.center[0].Y = kinematics_[h].p[1];
+        cone.center[0].Z = kinematics_[h].p[2];
+        cone.radius50[0] = cone.radius90[0] = 0.0f;
+    }
+
+    // Adapt the particle count to the budget; move gently, timings are noisy
+    lastMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double scale = lastMs_ > 0.0? std::min(2.0, std::max(0.5, settings.budgetMs / lastMs_)) : 2.0;
+    if (std::fabs(scale - 1.0) > 0.1)
+    {
+        int target = (int)(particles_ * (0.8 + 0.2 * scale));
+        target = scale > 1.0? (target + ParticleStep - 1) / ParticleStep * ParticleStep : target / ParticleStep * ParticleStep;
+        particles_ = std::min((int)MaxParticles, std::max((int)MinParticles, target));
+    }
+}
+
+bool TrajectoryForecaster::fit(History &history, int hand)
+{
+    Kinematics &k = kinematics_[hand];
+    points_.clear();
+    times_.clear();
+
+    const int now = (int)(window::getTime() * 1000.0);
+    history.GetWorldRecordsNewerThanTime(now - settings.fitWindowMs, points_, times_);
+
+    if ((int)points_.size() < MinFitPoints) return false;
+    lastTime_[hand] = times_[0];
+
+    // Least squares x(t) = p + v t + a t^2 / 2, t in seconds before the newest sample
+    double m[3][3] = {}, b[3][3] = {};
+    for (size_t i = 0; i < points_.size(); ++i)
+    {
+        double t = (times_[i] - times_[0]) * 0.001;
+        double basis[3] = { 1.0, t, 0.5 * t * t };
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c) m[r][c] += basis[r] * basis[c];
+            for (int d = 0; d < 3; ++d) b[d][r] += basis[r] * (&points_[i].X)[d];
+        }
+    }
+
+    double residual2 = 0.0;
+    for (int d = 0; d < 3; ++d)
+    {
+        double x[3];
+        if (!solve3(m, b[d], x))
+        {
+            // too few distinct times for a curve: hold still
+            x[0] = (&points_[0].X)[d];
+            x[1] = x[2] = 0.0;
+        }
+        k.p[d] = (float)x[0];
+        k.v[d] = (float)x[1];
+        k.a[d] = (float)x[2];
+
+        for (size_t i = 0; i < points_.size(); ++i)
+        {
+            double t = (times_[i] - times_[0]) * 0.001;
+            double e = (&points_[i].X)[d] - (x[0] + x[1] * t + 0.5 * x[2] * t * t);
+            residual2 += e * e;
+        }
+    }
+    k.residual = (float)std::sqrt(residual2 / points_.size());
+    return true;
+}
+
+void TrajectoryForecaster::simulate(int worker, int first, int end)
+{
+    Rng &rng = rngs_[worker];
+    const float dt = settings.horizon / Steps;
+    const float jerk = settings.jerkSigma * std::sqrt(dt);
+
+    for (int h = 0; h < HandCount; ++h)
+    {
+        if (!bActive_[h]) continue;
+        const Kinematics &k = kinematics_[h];
+
+        const float speed = std::sqrt(k.v[0] * k.v[0] + k.v[1] * k.v[1] + k.v[2] * k.v[2]);
+        const float sigmaV = settings.velocitySigma + 0.1f * speed;
+
+        for (int d = 0; d < 3; ++d)
+        {
+            for (int i = first; i < end; ++i)
+            {
+                float x = k.p[d] + k.residual * rng.normal();
+                float v = k.v[d] + sigmaV * rng.normal();
+                float a = k.a[d] + settings.accelerationSigma * rng.normal();
+                for (int s = 1; s <= Steps; ++s)
+                {
+                    a += jerk * rng.normal();
+                    v += a * dt;
+                    x += v * dt;
+                    positions(h, s, d)[i] = x;
+                }
+            }
+        }
+    }
+}
+
+void TrajectoryForecaster::percentiles(int worker, int task)
+{
+    const int h = task / Steps, s = 1 + task % Steps;
+    if (!bActive_[h]) return;
+
+    const int n = particles_;
+    std::vector<float> &work = scratch_[worker];
+    const float *x[3] = { positions(h, s, 0), positions(h, s, 1), positions(h, s, 2) };
+
+    // Median per axis
+    float center[3];
+    for (int d = 0; d < 3; ++d)
+    {
+        std::copy(x[d], x[d] + n, work.begin());
+        std::nth_element(work.begin(), work.begin() + n / 2, work.begin() + n);
+        center[d] = work[n / 2];
+    }
+
+    // Distances to the median, vectorizable
+    for (int i = 0; i < n; ++i)
+    {
+        float dx = x[0][i] - center[0], dy = x[1][i] - center[1], dz = x[2][i] - center[2];
+        work[i] = std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    const int i50 = n / 2, i90 = n * 9 / 10;
+    std::nth_element(work.begin(), work.begin() + i50, work.begin() + n);
+    float r50 = work[i50];
+    std::nth_element(work.begin() + i50, work.begin() + i90, work.begin() + n);
+    float r90 = work[i90];
+
+    Cone &cone = cones_[h];
+    cone.center[s].X = center[0];
+    cone.center[s].Y = center[1];
+    cone.center[s].Z = center[2];
+    cone.radius50[s] = r50;
+    cone.radius90[s] = r90;
+}
+
+void TrajectoryForecaster::parallelFor(int count, const std::function<void(int, int)> &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        jobCount_ = count;
+        nextIndex_ = 0;
+        pending_ = count;
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    // Take tasks here too, as worker 0
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (nextIndex_ < jobCount_)
+    {
+        int index = nextIndex_++;
+        lock.unlock();
+        job(0, index);
+        lock.lock();
+        --pending_;
+    }
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+}
+
+void TrajectoryForecaster::workerLoop(int worker)
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        wake_.wait(lock, [&] { return bQuit_ || generation_ != seen; });
+        if (bQuit_) return;
+        seen = generation_;
+
+        while (job_ && nextIndex_ < jobCount_)
+        {
+            int index = nextIndex_++;
+            const std::function<void(int, int)> &job = *job_;
+            lock.unlock();
+            job(worker, index);
+            lock.lock();
+            if (--pending_ == 0) done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef trajectory_forecast_hpp
+#define trajectory_forecast_hpp
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trajectory.hpp"
+
+// Trajectory forecast
+//
+// Monte-Carlo spread of where each hand may go next. The recent History of
+// a hand is fitted with a quadratic (position, velocity, acceleration); N
+// particles start from the fit with perturbed velocity and acceleration,
+// and follow a random-jerk motion over the horizon. Per step, the median
+// position and the 50th and 90th percentile distances to it give the cones
+// drawn over the RGB view.
+//
+// Particles are SoA, one array per step and axis, split across worker
+// threads that each have their own random generator; the percentiles are
+// split across threads by step. The particle count adapts every update to
+// keep the whole forecast within 'budgetMs'.
+//
+class TrajectoryForecaster
+{
+public:
+    enum Hand { Left, Right, HandCount };
+
+    static const int Steps = 16;
+    static const int MinParticles = 64;
+    static const int MaxParticles = 8192;
+
+    struct Settings
+    {
+        float horizon = 1.0f;               // seconds
+        int   fitWindowMs = 300;            // History used for the kinematics
+        float velocitySigma = 50.0f;        // millimeters per second, plus 10% of the speed
+        float accelerationSigma = 200.0f;   // millimeters per second squared
+        float jerkSigma = 600.0f;           // millimeters per second cubed
+        float budgetMs = 2.0f;              // per update, both hands
+    };
+
+    struct Cone
+    {
+        bool bValid = false;
+        XnPoint3D center[Steps + 1];        // median position, world millimeters; center[0] is the hand now
+        float radius50[Steps + 1];          // half the particles are closer to the center
+        float radius90[Steps + 1];
+    };
+
+    Settings settings;
+
+    TrajectoryForecaster();
+    ~TrajectoryForecaster();
+
+    /** Forecast both hands, if their History changed since the last update */
+    void update(History &leftHand, History &rightHand);
+
+    const Cone &cone(int hand) const { return cones_[hand]; }
+    int particles() const { return particles_; }
+    int threads() const { return (int)workers_.size() + 1; }
+    double lastMs() const { return lastMs_; }
+
+private:
+    struct Kinematics
+    {
+        float p[3], v[3], a[3];
+        float residual;                     // RMS of the fit, millimeters
+    };
+
+    struct Rng
+    {
+        uint64_t state;
+        uint64_t next();
+        float normal();                     // approximately standard normal
+    };
+
+    bool fit(History &history, int hand);
+    void simulate(int worker, int first, int end);
+    void percentiles(int worker, int task);
+
+    /** Run 'job(worker, index)' for index in [0, count), spread over the workers and this thread */
+    void parallelFor(int count, const std::function<void(int, int)> &job);
+    void workerLoop(int worker);
+
+    Kinematics kinematics_[HandCount];
+    bool bActive_[HandCount] = {};
+    int lastTime_[HandCount] = {};
+    Cone cones_[HandCount];
+
+    // Particle positions, SoA: [hand][step][axis] arrays of MaxParticles
+    std::vector<float> positions_;
+    float *positions(int hand, int step, int axis) { return &positions_[((hand * (Steps + 1) + step) * 3 + axis) * MaxParticles]; }
+
+    int particles_ = 1024;
+    double lastMs_ = 0.0;
+
+    // Workers
+    std::vector<std::thread> workers_;
+    std::vector<Rng> rngs_;
+    std::vector<std::vector<float>> scratch_;   // per worker, for the percentiles
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    const std::function<void(int, int)> *job_ = nullptr;
+    int jobCount_ = 0;
+    int nextIndex_ = 0;
+    int pending_ = 0;
+    uint64_t generation_ = 0;
+    bool bQuit_ = false;
+
+    std::vector<XnPoint3D> points_;             // fit scratch
+    std::vector<int> times_;
+};
+
+#endif /* trajectory_forecast_hpp */
@@ -0,0 +1,175 @@
+#include "trajectory_predictor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    const float MaxFrameGap = 0.5f;         // seconds: longer gaps restart the filter
+    const float MinConfidence = 0.5f;
+    const float ApproachSpeed = 300.0f;     // millimeters per second at which the approach curve takes over
+
+    inline float dot(const float *a, const float *b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+    inline XnPoint3D point(const float *p) { XnPoint3D pt; pt.X = p[0]; pt.Y = p[1]; pt.Z = p[2]; return pt; }
+
+    /** Smallest positive t with d = c t + ac t^2 / 2, -1 if none */
+    float solveContact(float d, float c, float ac)
+    {
+        if (d <= 0.0f) return 0.0f;
+        if (std::fabs(ac) < 1e-3f) return c > 0.0f? d / c : -1.0f;
+
+        float disc = c * c + 2.0f * ac * d;
+        if (disc < 0.0f) return -1.0f; // decelerates to a stop before reaching it
+
+        float root = std::sqrt(disc);
+        float t0 = (-c - root) / ac, t1 = (-c + root) / ac;
+        if (t0 > t1) std::swap(t0, t1);
+        return t0 > 0.0f? t0 : (t1 > 0.0f? t1 : -1.0f);
+    }
+}
+
+
+// TrajectoryPredictor
+//
+void TrajectoryPredictor::setTargets(const XnPoint3D *targets, int count)
+{
+    targetCount_ = std::min(count, (int)MaxTargets);
+    std::copy(targets, targets + targetCount_, targets_);
+}
+
+void TrajectoryPredictor::reset()
+{
+    userId_ = 0;
+    for (auto &hand : hands_) hand = HandState();
+}
+
+void TrajectoryPredictor::update(uint64_t timestamp, const session::SkeletonRecord &user)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (user.userId != userId_)
+    {
+        reset();
+        userId_ = user.userId;
+    }
+
+    const XnSkeletonJoint joints[HandCount] = { XN_SKEL_LEFT_HAND, XN_SKEL_RIGHT_HAND };
+    for (int h = 0; h < HandCount; ++h)
+    {
+        const session::SkeletonJoint &joint = user.joints[joints[h] - 1];
+        if (joint.confidence >= MinConfidence) filter(hands_[h], &joint.x, timestamp);
+        if (!hands_[h].bValid) continue;
+
+        for (int t = 0; t < targetCount_; ++t)
+        {
+            predict(hands_[h], targets_[t], predictions_[h][t]);
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    averageMs_ = averageMs_ * 0.95 + elapsed * 0.05;
+}
+
+int TrajectoryPredictor::likelyTarget(int hand) const
+{
+    if (!hands_[hand].bValid) return -1;
+
+    int best = -1;
+    for (int t = 0; t < targetCount_; ++t)
+    {
+        float ttc = predictions_[hand][t].timeToContact;
+        if (ttc >= 0.0f && (best < 0 || ttc < predictions_[hand][best].timeToContact)) best = t;
+    }
+    return best;
+}
+
+void TrajectoryPredictor::filter(HandState &hand, const float *z, uint64_t timestamp)
+{
+    const float dt = hand.bValid? (timestamp - hand.timestamp) * 1e-6f : 0.0f;
+    if (!(dt > 0.0f && dt < MaxFrameGap))
+    {
+        // first sample, or a gap: at rest where the hand is
+        std::copy(z, z + 3, hand.p);
+        std::fill(hand.v, hand.v + 3, 0.0f);
+        std::fill(hand.a, hand.a + 3, 0.0f);
+        hand.timestamp = timestamp;
+        hand.bValid = true;
+        return;
+    }
+
+    // Predict, then correct with the residual
+    for (int k = 0; k < 3; ++k)
+    {
+        float predicted = hand.p[k] + hand.v[k] * dt + 0.5f * hand.a[k] * dt * dt;
+        float r = z[k] - predicted;
+
+        hand.p[k] = predicted + settings.alpha * r;
+        hand.v[k] += hand.a[k] * dt + settings.beta * r / dt;
+        hand.a[k] += settings.gamma * 2.0f * r / (dt * dt);
+    }
+
+    float a2 = dot(hand.a, hand.a), maxA = settings.maxAcceleration;
+    if (a2 > maxA * maxA)
+    {
+        float scale = maxA / std::sqrt(a2);
+        for (int k = 0; k < 3; ++k) hand.a[k] *= scale;
+    }
+    hand.timestamp = timestamp;
+}
+
+void TrajectoryPredictor::predict(const HandState &hand, const XnPoint3D &target, Prediction &prediction) const
+{
+    const float *p = hand.p, *v = hand.v, *a = hand.a;
+
+    float toTarget[3] = { target.X - p[0], target.Y - p[1], target.Z - p[2] };
+    float distance = std::sqrt(dot(toTarget, toTarget));
+    float dir[3] = { 0.0f, 0.0f, 0.0f };
+    if (distance > 1e-3f)
+    {
+        for (int k = 0; k < 3; ++k) dir[k] = toTarget[k] / distance;
+    }
+
+    // Time to contact, along the direction of the target
+    float closing = dot(v, dir);
+    prediction.timeToContact = solveContact(distance - settings.contactRadius, closing, dot(a, dir));
+    if (prediction.timeToContact > settings.maxTimeToContact) prediction.timeToContact = -1.0f;
+
+    // Approach curve weight: heading straight at the target, and fast enough to mean it
+    float speed = std::sqrt(dot(v, v));
+    float heading = speed > 1e-3f? std::max(0.0f, closing / speed) : 0.0f;
+    prediction.blend = prediction.timeToContact >= 0.0f? heading * std::min(1.0f, speed / ApproachSpeed) : 0.0f;
+
+    // Bezier: leaves along the velocity, arrives along the approach direction, in 'arrival' seconds
+    const float arrival = prediction.timeToContact > 0.0f? prediction.timeToContact : settings.horizon;
+    float c[4][3];
+    for (int k = 0; k < 3; ++k)
+    {
+        c[0][k] = p[k];
+        c[1][k] = p[k] + v[k] * arrival / 3.0f;
+        c[2][k] = (&target.X)[k] - dir[k] * distance / 3.0f;
+        c[3][k] = (&target.X)[k];
+    }
+    for (int i = 0; i < 4; ++i) prediction.controlPoints[i] = point(c[i]);
+
+    const float w = prediction.blend;
+    for (int s = 0; s <= Steps; ++s)
+    {
+        float t = settings.horizon * s / Steps;
+        float u = std::min(t / arrival, 1.0f), iu = 1.0f - u;
+        float b0 = iu * iu * iu, b1 = 3.0f * iu * iu * u, b2 = 3.0f * iu * u * u, b3 = u * u * u;
+
+        float x[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            float ballistic = p[k] + v[k] * t + 0.5f * a[k] * t * t;
+            float curve = b0 * c[0][k] + b1 * c[1][k] + b2 * c[2][k] + b3 * c[3][k];
+            x[k] = (1.0f - w) * ballistic + w * curve;
+        }
+        prediction.path[s] = point(x);
+
+        float d[3] = { (&target.X)[0] - x[0], (&target.X)[1] - x[1], (&target.X)[2] - x[2] };
+        prediction.distance[s] = std::sqrt(dot(d, d));
+    }
+}
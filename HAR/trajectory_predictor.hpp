@@ -0,0 +1,91 @@
+#ifndef trajectory_predictor_hpp
+#define trajectory_predictor_hpp
+
+#include <cstdint>
+
+#include <XnOpenNI.h>
+
+#include "session.hpp"
+
+// Trajectory predictor
+//
+// Forecasts where each hand of the focus user is heading, over 'horizon'
+// seconds, toward one target (the head) or several (the heads of everyone
+// in view, in the multi target screen).
+//
+// Every skeleton frame, each hand feeds a constant-acceleration alpha-beta-
+// gamma filter, O(1) per sample. For each target the forecast blends:
+//  - the ballistic path of the filter: p + v t + a t^2 / 2
+//  - a cubic Bezier approach curve that leaves the hand along its velocity
+//    and arrives at the target, timed by the time to contact
+// weighted by how directly the hand is moving toward the target. Time to
+// contact solves the filter motion along the direction of the target.
+//
+class TrajectoryPredictor
+{
+public:
+    enum Hand { Left, Right, HandCount };
+
+    static const int MaxTargets = 4;
+    static const int Steps = 16;        // forecast points after the current one
+
+    struct Settings
+    {
+        float horizon = 1.0f;           // seconds
+        float alpha = 0.6f;             // filter gains: position, velocity, acceleration
+        float beta = 0.3f;
+        float gamma = 0.03f;
+        float maxAcceleration = 8000.0f; // millimeters per second squared
+        float contactRadius = 120.0f;   // millimeters from the target center
+        float maxTimeToContact = 10.0f; // seconds: anything slower is not an approach
+    };
+
+    struct Prediction
+    {
+        XnPoint3D path[Steps + 1];      // world millimeters, path[k] at k * horizon / Steps
+        float distance[Steps + 1];      // to the target along the path
+        XnPoint3D controlPoints[4];     // Bezier approach curve
+        float timeToContact = -1.0f;    // seconds, -1 if the hand is not closing in
+        float blend = 0.0f;             // weight of the approach curve
+    };
+
+    Settings settings;
+
+    /** Targets of the next update, world millimeters */
+    void setTargets(const XnPoint3D *targets, int count);
+
+    /** One skeleton frame of the focus user; starts over when the user changes. 'timestamp' in microseconds. */
+    void update(uint64_t timestamp, const session::SkeletonRecord &user);
+    void reset();
+
+    uint32_t userId() const { return userId_; }
+    bool isTracking(int hand) const { return hands_[hand].bValid; }
+    int targetCount() const { return targetCount_; }
+    const XnPoint3D &target(int index) const { return targets_[index]; }
+    const Prediction &prediction(int hand, int target) const { return predictions_[hand][target]; }
+
+    /** Target the hand reaches first, -1 if it is closing in on none */
+    int likelyTarget(int hand) const;
+
+    double averageUpdateMs() const { return averageMs_; }
+
+private:
+    struct HandState
+    {
+        bool bValid = false;
+        uint64_t timestamp = 0;
+        float p[3], v[3], a[3];         // filter state, millimeters and seconds
+    };
+
+    void filter(HandState &hand, const float *z, uint64_t timestamp);
+    void predict(const HandState &hand, const XnPoint3D &target, Prediction &prediction) const;
+
+    uint32_t userId_ = 0;
+    HandState hands_[HandCount];
+    XnPoint3D targets_[MaxTargets];
+    int targetCount_ = 0;
+    Prediction predictions_[HandCount][MaxTargets];
+    double averageMs_ = 0.0;
+};
+
+#endif /* trajectory_predictor_hpp */
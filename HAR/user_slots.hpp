@@ -0,0 +1,126 @@
+#ifndef user_slots_hpp
+#define user_slots_hpp
+
+#include <chrono>
+#include <cstdint>
+
+// User slots
+//
+// Per-user state of the skeleton pipeline (gap filler, joint filters,
+// features, classifier, states), in a fixed table with one slot per tracked
+// user. A user keeps its slot until it is removed, or until it has had no
+// frame for 'UserTimeout'; the slot then goes to the next new user. Slots are
+// looked up by user id, so the modules agree on who is who even when their
+// slot numbers differ.
+//
+const int MaxTrackedUsers = 6;
+
+template <class State, int MaxUsers = MaxTrackedUsers>
+class UserSlots
+{
+public:
+    static const uint64_t UserTimeout = 2000000;   // microseconds without a frame before a slot is reused
+
+    /** Slot of a user, -1 if it has none */
+    int find(uint32_t userId) const
+    {
+        for (int slot = 0; slot < MaxUsers; ++slot)
+        {
+            if (userId != 0 && userIds_[slot] == userId) return slot;
+        }
+        return -1;
+    }
+
+    /**
+     * Slot of a user seen at 'timestamp' (microseconds), giving it a free or stale slot if it
+     * has none, reset to State(); -1 if every slot is taken. 'release(slot)' is called before a
+     * stale user's state is reset.
+     */
+    template <class Release>
+    int acquire(uint32_t userId, uint64_t timestamp, Release release)
+    {
+        int free = -1;
+        for (int slot = 0; slot < MaxUsers; ++slot)
+        {
+            if (userIds_[slot] == userId)
+            {
+                seen_[slot] = timestamp;
+                return slot;
+            }
+
+            bool bStale = userIds_[slot] != 0 && timestamp > seen_[slot] + UserTimeout;
+            if (free < 0 && (userIds_[slot] == 0 || bStale)) free = slot;
+        }
+
+        if (free >= 0)
+        {
+            if (userIds_[free] != 0) release(free);
+            states_[free] = State();
+            userIds_[free] = userId;
+            seen_[free] = timestamp;
+        }
+        return free;
+    }
+
+    int acquire(uint32_t userId, uint64_t timestamp) { return acquire(userId, timestamp, [](int) {}); }
+
+    /** Frees the slot of a user, calling 'release(slot)' before its state is reset */
+    template <class Release>
+    void remove(uint32_t userId, Release release)
+    {
+        int slot = find(userId);
+        if (slot < 0) return;
+
+        release(slot);
+        states_[slot] = State();
+        userIds_[slot] = 0;
+        seen_[slot] = 0;
+    }
+
+    void remove(uint32_t userId) { remove(userId, [](int) {}); }
+
+    /** 0 when the slot is free */
+    uint32_t userId(int slot) const { return userIds_[slot]; }
+
+    /** Time of the last acquire */
+    uint64_t lastSeen(int slot) const { return seen_[slot]; }
+
+    State &operator[](int slot) { return states_[slot]; }
+    const State &operator[](int slot) const { return states_[slot]; }
+
+    /** nullptr if the user has no slot */
+    State *state(uint32_t userId) { int slot = find(userId); return slot >= 0? &states_[slot] : nullptr; }
+    const State *state(uint32_t userId) const { int slot = find(userId); return slot >= 0? &states_[slot] : nullptr; }
+
+private:
+    uint32_t userIds_[MaxUsers] = {};
+    uint64_t seen_[MaxUsers] = {};
+    State states_[MaxUsers];
+};
+
+
+// Update timer
+//
+// Smoothed duration of a module's update, for the Properties panel.
+//
+class UpdateTimer
+{
+public:
+    void begin() { start_ = std::chrono::steady_clock::now(); }
+
+    /** Milliseconds since begin(), also folded into the average */
+    double end()
+    {
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        averageMs_ = averageMs_ * 0.95 + elapsed * 0.05;
+        return elapsed;
+    }
+
+    double averageMs() const { return averageMs_; }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    double averageMs_ = 0.0;
+};
+
+#endif /* user_slots_hpp */
@@ -0,0 +1,45 @@
+#if VERTEX_SHADER
+
+uniform mat4 projection;
+
+attribute vec2 position;        // t along the curve, side -1 or 1
+attribute vec4 p01;             // control points, in pixels
+attribute vec4 p23;
+attribute float width;
+attribute vec4 color0;          // at t = 0
+attribute vec4 color1;          // at t = 1
+
+varying vec4 vColor;
+varying float vEdge;            // pixels across the curve
+varying float vHalfWidth;
+
+void main()
+{
+    float t = position.x, s = 1.0 - t;
+    vec2 p0 = p01.xy, p1 = p01.zw, p2 = p23.xy, p3 = p23.zw;
+    
+    vec2 point = s * s * s * p0 + 3.0 * s * s * t * p1 + 3.0 * s * t * t * p2 + t * t * t * p3;
+    vec2 tangent = 3.0 * s * s * (p1 - p0) + 6.0 * s * t * (p2 - p1) + 3.0 * t * t * (p3 - p2);
+    float speed = length(tangent);
+    vec2 normal = speed > 1e-3 ? vec2(-tangent.y, tangent.x) / speed : vec2(0.0, 1.0);
+    
+    // a pixel wider than the line on each side, for the feathered edge
+    vHalfWidth = 0.5 * width;
+    vEdge = position.y * (vHalfWidth + 1.0);
+    vColor = mix(color0, color1, t);
+    gl_Position = projection * vec4(point + normal * vEdge, 0, 1);
+}
+
+#elif FRAGMENT_SHADER
+
+varying vec4 vColor;
+varying float vEdge;
+varying float vHalfWidth;
+
+void main()
+{
+    float coverage = clamp(vHalfWidth + 0.5 - abs(vEdge), 0.0, 1.0);
+    fragColor = vec4(vColor.rgb, vColor.a * coverage);
+}
+
+#endif
@@ -1,18 +1,27 @@
 #if VERTEX_SHADER
 
+uniform mat4 projection;
+
+attribute vec2 position;
+attribute vec2 texCoord;
+
+varying vec2 vTexCoord;
+
 void main()
 {
-    gl_TexCoord[0] = gl_MultiTexCoord0;
-    gl_Position = gl_ModelViewProjectionMatrix * vec4(gl_Vertex.x, gl_Vertex.y, 0, 1);
+    vTexCoord = texCoord;
+    gl_Position = projection * vec4(position, 0, 1);
 }
 
 #elif FRAGMENT_SHADER
 
 uniform sampler2DRect texRect;
 
+varying vec2 vTexCoord;
+
 void main()
 {
-    gl_FragColor = texture2DRect(texRect, gl_TexCoord[0].st);
+    fragColor = texture2DRect(texRect, vTexCoord);
 }
 
 #endif
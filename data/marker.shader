@@ -0,0 +1,26 @@
+#if VERTEX_SHADER
+
+uniform mat4 projection;
+
+attribute vec2 position;        // unit mesh
+attribute vec3 instance;        // x, y, size
+attribute vec4 color;
+
+varying vec4 vColor;
+
+void main()
+{
+    vColor = color;
+    gl_Position = projection * vec4(instance.xy + position * instance.z, 0, 1);
+}
+
+#elif FRAGMENT_SHADER
+
+varying vec4 vColor;
+
+void main()
+{
+    fragColor = vColor;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#if VERTEX_SHADER
+
+uniform mat4 projection;
+
+attribute vec2 position;
+attribute vec4 color;
+
+varying vec4 vColor;
+
+void main()
+{
+    vColor = color;
+    gl_Position = projection * vec4(position, 0, 1);
+}
+
+#elif FRAGMENT_SHADER
+
+varying vec4 vColor;
+
+void main()
+{
+    fragColor = vColor;
+}
+
+#endif
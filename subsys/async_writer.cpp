@@ -0,0 +1,486 @@
+#include "async_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unistd.h>
+#include <sys/uio.h>
+
+// Opt in with -DHAR_USE_IO_URING, together with -luring on the link line
+#if defined(__linux__) && defined(HAR_USE_IO_URING) && HAR_USE_IO_URING
+#include <liburing.h>
+#define HAR_HAVE_IO_URING 1
+#endif
+
+namespace
+{
+    using namespace session;
+
+    const size_t PageSize = 4096;
+
+    uint8_t *allocate(size_t size)
+    {
+        // page aligned: required for O_DIRECT, and cheaper to pin for io_uring
+        void *p = nullptr;
+        return ::posix_memalign(&p, PageSize, size) == 0? (uint8_t *)p : nullptr;
+    }
+
+    double now()
+    {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
+
+
+// Thread pool backend
+//
+    class ThreadPoolBackend : public AsyncWriter::Backend
+    {
+    public:
+        ThreadPoolBackend(AsyncWriter &owner, int threadCount)
+        : owner_(owner)
+        {
+            for (int i = 0; i < std::max(1, threadCount); ++i)
+            {
+                threads_.emplace_back([this]() { run(); });
+            }
+        }
+
+        ~ThreadPoolBackend()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                bStop_ = true;
+            }
+            cv_.notify_all();
+            for (auto &t : threads_) t.join();
+        }
+
+        const char *name() const override { return "threads"; }
+
+        void submit(AsyncWriter::Buffer *buffer) override
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(buffer);
+            }
+            cv_.notify_one();
+        }
+
+    private:
+        void run()
+        {
+            for (;;)
+            {
+                AsyncWriter::Buffer *buffer;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return bStop_ || !queue_.empty(); });
+                    if (queue_.empty()) return; // stopping, and nothing left to write
+
+                    buffer = queue_.front();
+                    queue_.pop_front();
+                }
+
+                bool bOk = true;
+                while (buffer->done < buffer->used)
+                {
+                    ssize_t n = ::pwrite(buffer->fd, buffer->data + buffer->done,
+                                         buffer->used - buffer->done, (off_t)(buffer->offset + buffer->done));
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n <= 0)
+                    {
+                        bOk = false;
+                        break;
+                    }
+                    buffer->done += n;
+                }
+                owner_.complete(buffer, bOk);
+            }
+        }
+
+        AsyncWriter &owner_;
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<AsyncWriter::Buffer *> queue_;
+        bool bStop_ = false;
+    };
+
+
+#ifdef HAR_HAVE_IO_URING
+// io_uring backend
+//
+// The producer thread prepares and submits SQEs; a completion thread reaps
+// CQEs and resubmits the remainder of short writes. Both go through the
+// submission queue, hence 'sqMutex_'.
+//
+    class IoUringBackend : public AsyncWriter::Backend
+    {
+    public:
+        static std::unique_ptr<IoUringBackend> create(AsyncWriter &owner, const std::vector<AsyncWriter::Buffer *> &buffers, int batch)
+        {
+            std::unique_ptr<IoUringBackend> backend(new IoUringBackend(owner, batch));
+
+            unsigned entries = 64;
+            while (entries < buffers.size() * 2) entries *= 2;
+            if (io_uring_queue_init(entries, &backend->ring_, 0) < 0) return nullptr;
+            backend->bRing_ = true;
+
+            std::vector<struct iovec> iov;
+            for (auto *b : buffers) iov.push_back({ b->data, b->capacity });
+            if (!iov.empty() && io_uring_register_buffers(&backend->ring_, iov.data(), (unsigned)iov.size()) < 0)
+            {
+                // still usable, only without fixed buffers
+                for (auto *b : buffers) b->index = -1;
+            }
+
+            backend->thread_ = std::thread([p = backend.get()]() { p->reap(); });
+            return backend;
+        }
+
+        ~IoUringBackend()
+        {
+            if (thread_.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(sqMutex_);
+                    struct io_uring_sqe *sqe = getSqe();
+                    io_uring_prep_nop(sqe);
+                    io_uring_sqe_set_data(sqe, nullptr); // tells the completion thread to exit
+                    io_uring_submit(&ring_);
+                }
+                thread_.join();
+            }
+            if (bRing_) io_uring_queue_exit(&ring_);
+        }
+
+        const char *name() const override { return "io_uring"; }
+
+        void submit(AsyncWriter::Buffer *buffer) override
+        {
+            std::lock_guard<std::mutex> lock(sqMutex_);
+            prepare(buffer);
+            if (++queued_ >= batch_)
+            {
+                io_uring_submit(&ring_);
+                queued_ = 0;
+            }
+        }
+
+        void kick() override
+        {
+            std::lock_guard<std::mutex> lock(sqMutex_);
+            if (queued_ > 0)
+            {
+                io_uring_submit(&ring_);
+                queued_ = 0;
+            }
+        }
+
+    private:
+        IoUringBackend(AsyncWriter &owner, int batch)
+        : owner_(owner), batch_(std::max(1, batch))
+        {
+        }
+
+        struct io_uring_sqe *getSqe()
+        {
+            struct io_uring_sqe *sqe;
+            while ((sqe = io_uring_get_sqe(&ring_)) == nullptr)
+            {
+                io_uring_submit(&ring_); // queue full, make room
+                queued_ = 0;
+            }
+            return sqe;
+        }
+
+        void prepare(AsyncWriter::Buffer *buffer)
+        {
+            struct io_uring_sqe *sqe = getSqe();
+            uint8_t *p = buffer->data + buffer->done;
+            unsigned n = (unsigned)(buffer->used - buffer->done);
+            uint64_t offset = buffer->offset + buffer->done;
+            if (buffer->index >= 0)
+            {
+                io_uring_prep_write_fixed(sqe, buffer->fd, p, n, offset, buffer->index);
+            }
+            else
+            {
+                io_uring_prep_write(sqe, buffer->fd, p, n, offset);
+            }
+            io_uring_sqe_set_data(sqe, buffer);
+        }
+
+        void reap()
+        {
+            for (;;)
+            {
+                struct io_uring_cqe *cqe;
+                int ret = io_uring_wait_cqe(&ring_, &cqe);
+                if (ret == -EINTR) continue;
+                if (ret < 0) return;
+
+                auto *buffer = (AsyncWriter::Buffer *)io_uring_cqe_get_data(cqe);
+                int res = cqe->res;
+                io_uring_cqe_seen(&ring_, cqe);
+
+                if (!buffer) return; // shutdown
+
+                if (res == -EINTR || res == -EAGAIN)
+                {
+                    resubmit(buffer);
+                    continue;
+                }
+                if (res <= 0)
+                {
+                    owner_.complete(buffer, false);
+                    continue;
+                }
+
+                buffer->done += res;
+                if (buffer->done < buffer->used)
+                {
+                    resubmit(buffer); // short write
+                    continue;
+                }
+                owner_.complete(buffer, true);
+            }
+        }
+
+        void resubmit(AsyncWriter::Buffer *buffer)
+        {
+            std::lock_guard<std::mutex> lock(sqMutex_);
+            prepare(buffer);
+            io_uring_submit(&ring_);
+            queued_ = 0;
+        }
+
+        AsyncWriter &owner_;
+        struct io_uring ring_;
+        bool bRing_ = false;
+        std::thread thread_;
+        std::mutex sqMutex_;
+        int batch_;
+        int queued_ = 0;
+    };
+#endif
+}
+
+
+namespace session
+{
+// AsyncWriter
+//
+    AsyncWriter::AsyncWriter()
+    : AsyncWriter(Settings())
+    {
+    }
+
+    AsyncWriter::AsyncWriter(const Settings &settings)
+    : settings_(settings)
+    {
+        settings_.bufferSize = std::max<size_t>(settings_.bufferSize, PageSize);
+        if (settings_.alignment > 1)
+        {
+            settings_.bufferSize -= settings_.bufferSize % settings_.alignment;
+        }
+
+        std::vector<Buffer *> registered;
+        for (int i = 0; i < settings_.registeredBuffers; ++i)
+        {
+            std::unique_ptr<Buffer> b(new Buffer);
+            b->data = allocate(settings_.bufferSize);
+            if (!b->data) break;
+            b->capacity = settings_.bufferSize;
+            b->index = i;
+            registered.push_back(b.get());
+            free_.push_back(b.get());
+            buffers_.push_back(std::move(b));
+        }
+
+#ifdef HAR_HAVE_IO_URING
+        backend_ = IoUringBackend::create(*this, registered, settings_.submitBatch);
+#endif
+        if (!backend_)
+        {
+            backend_.reset(new ThreadPoolBackend(*this, settings_.workerThreads));
+        }
+
+        lastSampleTime_ = now();
+    }
+
+    AsyncWriter::~AsyncWriter()
+    {
+        drain();
+        backend_.reset(); // stops the backend threads before the buffers go away
+
+        if (current_) recycle(current_);
+        for (auto &b : buffers_) std::free(b->data);
+    }
+
+    bool AsyncWriter::write(int fd, uint64_t offset, const void *data, size_t size)
+    {
+        if (bError_) return false;
+
+        auto *src = (const uint8_t *)data;
+        while (size > 0)
+        {
+            // Continue the current buffer when this write follows it in the same file
+            if (current_ && (current_->fd != fd || current_->offset + current_->used != offset ||
+                             current_->used == current_->capacity))
+            {
+                submitCurrent(current_->used != current_->capacity);
+            }
+            if (!current_)
+            {
+                current_ = acquire();
+                if (!current_) return false;
+                current_->fd = fd;
+                current_->offset = offset;
+            }
+
+            size_t n = std::min(size, current_->capacity - current_->used);
+            memcpy(current_->data + current_->used, src, n);
+            current_->used += n;
+            src += n;
+            offset += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    void AsyncWriter::flush()
+    {
+        if (current_) submitCurrent(false);
+        backend_->kick();
+    }
+
+    void AsyncWriter::drain()
+    {
+        if (current_) submitCurrent(true);
+        backend_->kick();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return buffersInFlight_ == 0; });
+    }
+
+    AsyncWriter::Stats AsyncWriter::stats()
+    {
+        stats_.bytesCompleted = bytesCompleted_;
+        stats_.writesCompleted = writesCompleted_;
+
+        double t = now();
+        if (t - lastSampleTime_ >= 1.0)
+        {
+            stats_.throughput = (stats_.bytesCompleted - lastSampleBytes_) / (t - lastSampleTime_);
+            lastSampleTime_ = t;
+            lastSampleBytes_ = stats_.bytesCompleted;
+        }
+        return stats_;
+    }
+
+    void AsyncWriter::complete(Buffer *buffer, bool bOk)
+    {
+        if (bOk)
+        {
+            bytesCompleted_ += buffer->used;
+            ++writesCompleted_;
+        }
+        else if (!bError_.exchange(true))
+        {
+            fprintf(stderr, "session::AsyncWriter: write of %zu bytes at %llu failed\n",
+                    buffer->used, (unsigned long long)buffer->offset);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(buffer);
+            --buffersInFlight_;
+        }
+        cv_.notify_all();
+    }
+
+    AsyncWriter::Buffer *AsyncWriter::acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty() && buffers_.size() * settings_.bufferSize < settings_.maxBytesInFlight)
+        {
+            // Disk is behind: grow rather than make the caller wait. Extra buffers are not registered.
+            std::unique_ptr<Buffer> b(new Buffer);
+            b->data = allocate(settings_.bufferSize);
+            if (b->data)
+            {
+                b->capacity = settings_.bufferSize;
+                free_.push_back(b.get());
+                buffers_.push_back(std::move(b));
+                ++stats_.extraBuffers;
+            }
+        }
+        if (free_.empty())
+        {
+            ++stats_.stalls;
+            cv_.wait(lock, [this]() { return !free_.empty() || bError_; });
+            if (free_.empty()) return nullptr;
+        }
+
+        Buffer *b = free_.back();
+        free_.pop_back();
+        b->used = b->done = 0;
+        return b;
+    }
+
+    void AsyncWriter::recycle(Buffer *buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+
+    void AsyncWriter::submitCurrent(bool bPad)
+    {
+        Buffer *b = current_;
+        current_ = nullptr;
+
+        const size_t alignment = settings_.alignment;
+        const size_t partial = alignment > 1? b->used % alignment : 0;
+        if (partial && bPad)
+        {
+            memset(b->data + b->used, 0, alignment - partial);
+            b->used += alignment - partial;
+        }
+        else if (partial)
+        {
+            // Only whole blocks can be written: the partial one moves to a fresh buffer and waits for more data
+            if (b->used == partial)
+            {
+                current_ = b;
+                return;
+            }
+
+            Buffer *next = acquire();
+            if (!next)
+            {
+                recycle(b);
+                return;
+            }
+            b->used -= partial;
+            memcpy(next->data, b->data + b->used, partial);
+            next->used = partial;
+            next->fd = b->fd;
+            next->offset = b->offset + b->used;
+            current_ = next;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++buffersInFlight_;
+        }
+        stats_.bytesSubmitted += b->used;
+        backend_->submit(b);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef async_writer_hpp
+#define async_writer_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// Asynchronous file writer
+//
+// Copies data into staging buffers and hands full buffers to a backend that
+// writes them in the background, so the caller never waits on the disk.
+// Consecutive writes to the same file are coalesced into one buffer.
+//
+// Backends:
+//  - io_uring (Linux, built with -DHAR_USE_IO_URING and linked with -luring):
+//    the staging buffers are registered with the ring and writes are
+//    submitted in batches.
+//  - thread pool: worker threads doing pwrite(). Used everywhere else, or
+//    when the ring cannot be created.
+//
+namespace session
+{
+    class AsyncWriter
+    {
+    public:
+        struct Settings
+        {
+            size_t bufferSize = 1024 * 1024;
+            int    registeredBuffers = 32;                  // allocated up front
+            size_t maxBytesInFlight = 256 * 1024 * 1024;    // extra buffers are allocated up to this
+            int    workerThreads = 2;                       // thread pool backend only
+            int    submitBatch = 8;                         // io_uring backend only
+            size_t alignment = 0;                           // O_DIRECT block size, 0 when not needed
+        };
+
+        struct Stats
+        {
+            uint64_t bytesSubmitted = 0;
+            uint64_t bytesCompleted = 0;
+            uint64_t writesCompleted = 0;
+            uint64_t extraBuffers = 0;      // buffers allocated beyond 'registeredBuffers'
+            uint64_t stalls = 0;            // times write() had to wait for a buffer
+            double   throughput = 0.0;      // bytes per second, over the last second or so
+        };
+
+        struct Buffer
+        {
+            uint8_t *data = nullptr;
+            size_t capacity = 0;
+            size_t used = 0;
+            size_t done = 0;                // bytes already written, for short writes
+            int fd = -1;
+            uint64_t offset = 0;            // file offset of data[0]
+            int index = -1;                 // registered buffer index, -1 if not registered
+        };
+
+        class Backend
+        {
+        public:
+            virtual ~Backend() {}
+            virtual const char *name() const = 0;
+            virtual void submit(Buffer *buffer) = 0;
+            virtual void kick() {}
+        };
+
+        AsyncWriter();
+        explicit AsyncWriter(const Settings &settings);
+        ~AsyncWriter();
+
+        /** Queue 'size' bytes for writing at 'offset'. Blocks only when 'maxBytesInFlight' is reached. */
+        bool write(int fd, uint64_t offset, const void *data, size_t size);
+
+        /** Submit the partially filled buffer, if any. With 'alignment', a trailing partial block is held back. */
+        void flush();
+
+        /**
+         * Submit everything and wait until every queued write has completed.
+         * With 'alignment', the last block is padded with zeros: the caller truncates the file.
+         */
+        void drain();
+
+        bool hasError() const { return bError_; }
+        Stats stats();
+        const char *backendName() const { return backend_->name(); }
+
+        /** Called by backends when a buffer has been written, or failed */
+        void complete(Buffer *buffer, bool bOk);
+
+    private:
+        AsyncWriter(const AsyncWriter &) = delete;
+        AsyncWriter &operator= (const AsyncWriter &) = delete;
+
+        Buffer *acquire();
+        void recycle(Buffer *buffer);
+        void submitCurrent(bool bPad);
+
+        Settings settings_;
+        std::unique_ptr<Backend> backend_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<std::unique_ptr<Buffer>> buffers_;
+        std::vector<Buffer *> free_;
+        size_t buffersInFlight_ = 0;
+
+        Buffer *current_ = nullptr;
+        std::atomic<bool> bError_ { false };
+
+        Stats stats_;
+        std::atomic<uint64_t> bytesCompleted_ { 0 };
+        std::atomic<uint64_t> writesCompleted_ { 0 };
+        double lastSampleTime_ = 0.0;
+        uint64_t lastSampleBytes_ = 0;
+    };
+}
+
+#endif /* async_writer_hpp */
@@ -52,11 +52,14 @@ namespace
             case Texture::Format::Bgra8:
                 return GL_RGBA;//GL_BGRA;
                 
+            case Texture::Format::Rgba8:
+                return GL_RGBA;
+                
             case Texture::Format::Bgr8:
                 return GL_RGB;//GL_BGR;
                 
             case Texture::Format::L8:
-                return GL_LUMINANCE;
+                return window::isLegacyOpenGL()? GL_LUMINANCE : GL_RED; // core: swizzled back to gray, see Texture()
                 
             default:
                 assert(false && "Unsupported texture format!");
@@ -64,6 +67,12 @@ namespace
         return 0;
     }
     
+    GLenum gl4InternalFormat(Texture::Format fmt)
+    {
+        if (fmt == Texture::Format::Rgba8) return GL_RGBA8; // sized, to render into
+        return fmt == Texture::Format::L8 && !window::isLegacyOpenGL()? GL_R8 : gl4Format(fmt);
+    }
+    
     GLenum gl4Type(Texture::Format fmt)
     {
         switch (fmt)
@@ -71,6 +80,7 @@ namespace
             case Texture::Format::Rgb8:
             case Texture::Format::Bgra8:
             case Texture::Format::Bgr8:
+            case Texture::Format::Rgba8:
             case Texture::Format::L8:
                 return GL_UNSIGNED_BYTE;
                 
@@ -140,7 +150,13 @@ namespace gfx
         glTexParameterf(GL_TEX_TYPE, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameterf(GL_TEX_TYPE, GL_TEXTURE_WRAP_T, GL_REPEAT);
         
-        glTexImage2D(GL_TEX_TYPE, 0, gl4Format(format), width, height, 0, gl4Format(format), gl4Type(format), pixelData);
+        if (format == Format::L8 && !window::isLegacyOpenGL())
+        {
+            const GLint gray[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+            glTexParameteriv(GL_TEX_TYPE, GL_TEXTURE_SWIZZLE_RGBA, gray);
+        }
+        
+        glTexImage2D(GL_TEX_TYPE, 0, gl4InternalFormat(format), width, height, 0, gl4Format(format), gl4Type(format), pixelData);
     }
     
     Texture::Texture(Texture &&other)
@@ -205,10 +221,200 @@ namespace gfx
         GLenum GL_TEX_TYPE = gl4TexType(type_);
         glBindTexture(GL_TEX_TYPE, tex_);
     }
-    
-    
+
+
+// StreamingBuffer
+//
+    StreamingBuffer::~StreamingBuffer()
+    {
+        release();
+    }
+
+    bool StreamingBuffer::init(size_t regionSize, int regionCount)
+    {
+        release(); // storage of a persistent buffer is immutable, so growing means a new buffer
+
+        regionSize_ = regionSize;
+        regionCount_ = std::min(std::max(regionCount, 1), (int)MaxRegions);
+        region_ = -1;
+
+        const GLsizeiptr size = regionSize_ * regionCount_;
+        glGenBuffers(1, &vbo_);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+
+        if (window::isLegacyOpenGL())
+        {
+            mode_ = Mode::Orphan;
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        else if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            persistent_ = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+            if (!persistent_)
+            {
+                fprintf(stderr, "StreamingBuffer::init(): cannot map %ld bytes persistently\n", (long)size);
+                release();
+                return false;
+            }
+            mode_ = Mode::Persistent;
+        }
+        else
+        {
+            mode_ = Mode::Unsynchronized;
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        return true;
+    }
+
+    void *StreamingBuffer::mapBytes(size_t size)
+    {
+        if (!vbo_ || size > regionSize_)
+        {
+            if (!init(std::max(size, 2 * regionSize_), regionCount_ > 0? regionCount_ : 3)) return nullptr;
+        }
+
+        if (mode_ == Mode::Orphan)
+        {
+            region_ = 0;
+            glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+            glBufferData(GL_ARRAY_BUFFER, regionSize_ * regionCount_, nullptr, GL_STREAM_DRAW);
+            return glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+        }
+
+        // Next region, once the GPU is done with it
+        region_ = (region_ + 1) % regionCount_;
+        if (GLsync fence = fences_[region_])
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                ++waits_;
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            }
+            glDeleteSync(fence);
+            fences_[region_] = nullptr;
+        }
+
+        const size_t offset = region_ * regionSize_;
+        if (mode_ == Mode::Persistent) return persistent_ + offset;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        return glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+
+    size_t StreamingBuffer::unmap()
+    {
+        if (mode_ != Mode::Persistent)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        return region_ * regionSize_;
+    }
+
+    void StreamingBuffer::fence()
+    {
+        if (mode_ == Mode::Orphan || region_ < 0) return;
+
+        if (fences_[region_]) glDeleteSync(fences_[region_]);
+        fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void StreamingBuffer::release()
+    {
+        for (auto &fence : fences_)
+        {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (vbo_)
+        {
+            glDeleteBuffers(1, &vbo_); // also unmaps
+            vbo_ = 0;
+        }
+        persistent_ = nullptr;
+    }
+
+
 // Program
 //
+    namespace
+    {
+        std::string programCacheDir() { return OutputData::GetOutputRoot() + "shader-cache/"; }
+        
+        bool hasProgramBinaries()
+        {
+            static GLint formats = -1;
+            if (formats < 0)
+            {
+                formats = 0;
+                if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            }
+            return formats > 0;
+        }
+        
+        /** Cache file of a program: its name, and a hash (FNV-1a) of its sources and of the driver */
+        std::string programCachePath(const std::string &shaderName, std::initializer_list<std::string> sources)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            auto add = [&hash](const std::string &text)
+            {
+                for (unsigned char c : text) hash = (hash ^ c) * 1099511628211ull;
+                hash = (hash ^ 0xff) * 1099511628211ull; // separator
+            };
+            for (auto &text : sources) add(text);
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+            {
+                auto *text = (const char *)glGetString(name);
+                add(text? text : "");
+            }
+            
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+            return programCacheDir() + boost::filesystem::path(shaderName).filename().string() + "-" + hex + ".bin";
+        }
+        
+        bool loadProgramBinary(GLuint prg, const std::string &path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) return false;
+            
+            GLenum format = 0;
+            file.read((char *)&format, sizeof(format));
+            std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (binary.empty()) return false;
+            
+            // the driver refuses binaries it did not write, or no longer reads
+            glProgramBinary(prg, format, binary.data(), (GLsizei)binary.size());
+            GLint result = GL_FALSE;
+            glGetProgramiv(prg, GL_LINK_STATUS, &result);
+            return result == GL_TRUE;
+        }
+        
+        void saveProgramBinary(GLuint prg, const std::string &path)
+        {
+            GLint length = 0;
+            glGetProgramiv(prg, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0) return;
+            
+            GLenum format = 0;
+            std::vector<char> binary(length);
+            glGetProgramBinary(prg, length, &length, &format, binary.data());
+            
+            boost::system::error_code error;
+            boost::filesystem::create_directories(programCacheDir(), error);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                fprintf(stderr, "Program::init(): cannot write %s\n", path.c_str());
+                return;
+            }
+            file.write((const char *)&format, sizeof(format));
+            file.write(binary.data(), length);
+        }
+    }
+    
     bool Program::init(const std::string &shaderName)
     {
         auto isCompilationError = [](GLuint shader, const std::string &filepath)
@@ -231,14 +437,39 @@ namespace gfx
         
         GLuint vs = 0, fs = 0;
         
-        std::string ver = "#version 120\n";
+        // Shaders are written once, in GLSL 1.20 with 'fragColor' for the output;
+        // on a core profile context the preamble maps that onto GLSL 4.10
+        std::string ver;
+        const char *defVS, *defFS;
+        if (window::isLegacyOpenGL())
+        {
+            ver = "#version 120\n";
+            defVS = "#define VERTEX_SHADER 1\n#define FRAGMENT_SHADER 0\n";
+            defFS = "#define VERTEX_SHADER 0\n#define FRAGMENT_SHADER 1\n#define fragColor gl_FragColor\n";
+        }
+        else
+        {
+            ver = "#version 410 core\n#define texture2D texture\n#define texture2DRect texture\n";
+            defVS = "#define VERTEX_SHADER 1\n#define FRAGMENT_SHADER 0\n#define attribute in\n#define varying out\n";
+            defFS = "#define VERTEX_SHADER 0\n#define FRAGMENT_SHADER 1\n#define varying in\nout vec4 fragColor;\n";
+        }
         auto filename = shaderName + ".shader";
         auto src = loadTextFile(filename);
         
+        // A binary of the same sources from an earlier run skips compiling and linking
+        std::string cachePath;
+        if (hasProgramBinaries() && !src.empty())
+        {
+            cachePath = programCachePath(shaderName, { ver, defVS, defFS, std::string(src.data(), src.size()) });
+            prg = glCreateProgram();
+            if (loadProgramBinary(prg, cachePath)) return true;
+            
+            glDeleteProgram(prg);
+            prg = 0;
+        }
         
         // create vertex shader
         {
-            const char *defVS = "#define VERTEX_SHADER 1\n#define FRAGMENT_SHADER 0\n";
             GLchar const* sources[] = { ver.c_str(), defVS, src.data() };
             GLint lengths[] = { (GLint)ver.size(), (GLint)strlen(defVS), (GLint)src.size() };
 
@@ -254,7 +485,6 @@ namespace gfx
 
         // create fragment shader
         {
-            const char *defFS = "#define VERTEX_SHADER 0\n#define FRAGMENT_SHADER 1\n";
             GLchar const* sources[] = { ver.c_str(), defFS, src.data() };
             GLint lengths[] = { (GLint)ver.size(), (GLint)strlen(defFS), (GLint)src.size() };
 
@@ -280,6 +510,7 @@ namespace gfx
         
         // link program
         {
+            if (!cachePath.empty()) glProgramParameteri(prg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
             glLinkProgram(prg);
             
             GLint length, result;
@@ -301,11 +532,27 @@ namespace gfx
             }
         }
         
+        if (!cachePath.empty()) saveProgramBinary(prg, cachePath);
+        
         return true;
     }
 
     
     
+// Dynamic Texture generator
+//
+    Texture *DynamicTextureGenerator::getOverlay()
+    {
+        if (tex_.platformHandle() == 0) return nullptr;
+        
+        if (overlay_.platformHandle() == 0 || overlay_.width() != tex_.width() || overlay_.height() != tex_.height())
+        {
+            overlay_ = Texture(tex_.width(), tex_.height(), Texture::Format::Rgba8);
+        }
+        return &overlay_;
+    }
+    
+    
 // DepthVisualization
 //
     void DepthVisualization::update()
@@ -447,26 +694,23 @@ namespace gfx
 //
     RGBFeed::RGBFeed()
     {
-        outdir_ = OutputData::GetOutputDir() +  "rgb_pre";
-        boost::filesystem::create_directory(outdir_);
-
-        outdir2_ = OutputData::GetOutputDir() +  "rgb_post";
-        boost::filesystem::create_directory(outdir2_);
     }
     
     RGBFeed::~RGBFeed()
     {
+        if (postPbos_[0]) glDeleteBuffers(2, postPbos_);
     }
     
     void RGBFeed::update()
     {
         if (!sensor::initialized()) return;
         
-        ++currentFrame_;
-        
         xn::ImageMetaData imd;
         sensor::imageGenerator().GetMetaData(imd);
         
+        frameId_ = imd.FrameID();
+        timestamp_ = imd.Timestamp();
+        
         if (!bInit)
         {
             bInit = true;
@@ -481,6 +725,7 @@ namespace gfx
             texHeight = getClosestPowerOfTwo(imd.YRes());
             
             imageTexBuf_.resize(texWidth * texHeight * 4);
+            overlayBuf_.resize(texWidth * texHeight * 4);
             
             tex_ = gfx::Texture(texWidth, texHeight, Texture::Format::Rgb8);
             
@@ -499,82 +744,233 @@ namespace gfx
 
         // Process this frame
         {
-            // Update texture data
+            // Update texture data; the overlay is drawn in its own layer, so
+            // a frame already in the texture is not uploaded again
             //
             {
-                const XnRGB24Pixel* pImageRow = imd.RGB24Data();
-                XnRGB24Pixel* pTexRow = (XnRGB24Pixel*)(imageTexBuf_.data() + imd.YOffset() * texWidth);
-                
-                for (XnUInt y = 0; y < imd.YRes(); ++y)
+                if (frameId_ != uploadedFrameId_)
                 {
-                    const XnRGB24Pixel* pImage = pImageRow;
-                    XnRGB24Pixel* pTex = pTexRow + imd.XOffset();
+                    uploadedFrameId_ = frameId_;
                     
-                    for (XnUInt x = 0; x < imd.XRes(); ++x, ++pImage, ++pTex)
+                    const XnRGB24Pixel* pImageRow = imd.RGB24Data();
+                    XnRGB24Pixel* pTexRow = (XnRGB24Pixel*)(imageTexBuf_.data() + imd.YOffset() * texWidth);
+                
+                    for (XnUInt y = 0; y < imd.YRes(); ++y)
                     {
-                        *pTex = *pImage;
-                    }
+                        const XnRGB24Pixel* pImage = pImageRow;
+                        XnRGB24Pixel* pTex = pTexRow + imd.XOffset();
                     
-                    pImageRow += imd.XRes();
-                    pTexRow += texWidth;
-                }
+                        for (XnUInt x = 0; x < imd.XRes(); ++x, ++pImage, ++pTex)
+                        {
+                            *pTex = *pImage;
+                        }
+                    
+                        pImageRow += imd.XRes();
+                        pTexRow += texWidth;
+                    }
 
-                tex_.updateTexelData((void *)imageTexBuf_.data());
+                    tex_.updateTexelData((void *)imageTexBuf_.data());
+                }
                 
-                // Write frame
+                // Write frame, once per frame: the main loop redraws when any generator updates
+                if (frameId_ != writtenFrameId_)
                 {
+                    writtenFrameId_ = frameId_;
+                    
                     cv::Mat rgb_image(imgH_, imgW_, CV_8UC3, imageTexBuf_.data(), texWidth * 3);
                     
                     cv::Mat bgr_image;
                     cv::cvtColor(rgb_image, bgr_image, cv::COLOR_BGR2RGB);
                  
                     // write to video
-                    if (video_pre.isOpened()) video_pre << bgr_image;
+                    if (video_pre.isOpened() && session::policy().isRecording()) video_pre << bgr_image;
 
-                    // write a jpg frame
-                    {
-                        std::string filename = outdir_ + "/frame" + std::to_string(currentFrame_);
-                        filename += ".jpeg";
-                        cv::imwrite(filename, bgr_image, {CV_IMWRITE_JPEG_QUALITY, jpegQualitySetting});
-                    }
+                    // write a jpg frame, or crops of the users in it
+                    if (recordingMode_ == RecordingMode::UserRoi)
+                        writeUserCrops(bgr_image);
+                    else
+                        writeFrame(session::ChunkType::RgbPreJpeg, bgr_image, frameId_, timestamp_);
                 }
             }
         }
     }
     
+    bool RGBFeed::isWritingPost() const
+    {
+        return session::policy().isCapturing() || (video_post.isOpened() && session::policy().isRecording());
+    }
+    
     void RGBFeed::captureFramebuffer()
     {
-        // Capture frame buffer
+        if (!bInit) return;
+        if (!isWritingPost())
         {
-            int currentFBORead;
-            int currentFBOWrite;
-            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &currentFBORead);
-            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentFBOWrite);
-    
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, currentFBOWrite);
-            glReadPixels(0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, imageTexBuf_.data());
-            //auto *err = glewGetErrorString(glGetError());
+            // nobody takes the frame; what is still in flight is dropped with it
+            postPending_[0].bPending = postPending_[1].bPending = false;
+            return;
+        }
+        if (frameId_ == postFrameId_) return;   // redrawn for another generator: this frame is written already
+        postFrameId_ = frameId_;
+        
+        int currentFBORead;
+        int currentFBOWrite;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &currentFBORead);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentFBOWrite);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, currentFBOWrite);
+        
+        if (!(GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object))
+        {
+            // Capture the overlay layer being drawn into, waiting for it
+            glReadPixels(0, 0, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_BYTE, overlayBuf_.data());
             glBindFramebuffer(GL_READ_FRAMEBUFFER, currentFBORead);
+            
+            writePost(overlayBuf_.data(), imageTexBuf_.data(), frameId_, timestamp_);
+            return;
         }
         
-        // Write frame
+        const GLsizeiptr size = texWidth * texHeight * 4;
+        if (postPbos_[0] == 0)
         {
-            cv::Mat rgb_image(imgH_, imgW_, CV_8UC3, imageTexBuf_.data(), texWidth * 3);
+            glGenBuffers(2, postPbos_);
+            for (GLuint pbo : postPbos_)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            }
+        }
+        
+        // Start copying this frame's layer into one buffer, without waiting for it
+        const int slot = postNext_;
+        postNext_ ^= 1;
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, postPbos_[slot]);
+        glReadPixels(0, 0, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, currentFBORead);
+        
+        PendingPost &pending = postPending_[slot];
+        pending.bPending = true;
+        pending.frameId = frameId_;
+        pending.timestamp = timestamp_;
+        pending.camera.assign(imageTexBuf_.begin(), imageTexBuf_.end());
+        
+        // ...and write the previous one, whose copy has had a frame to finish
+        PendingPost &previous = postPending_[slot ^ 1];
+        if (previous.bPending)
+        {
+            previous.bPending = false;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, postPbos_[slot ^ 1]);
+            if (auto *layer = (const unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY))
+            {
+                writePost(layer, previous.camera.data(), previous.frameId, previous.timestamp);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    
+    void RGBFeed::capturePlainFrame()
+    {
+        if (!bInit || !isWritingPost() || frameId_ == postFrameId_) return;
+        postFrameId_ = frameId_;
+        
+        writePost(nullptr, imageTexBuf_.data(), frameId_, timestamp_);
+    }
+    
+    void RGBFeed::writePost(const unsigned char *layer, const unsigned char *camera, XnUInt32 frameId, XnUInt64 timestamp)
+    {
+        // Composite the layer over the camera frame, as the GUI does (premultiplied color)
+        postImage_.create(imgH_, imgW_, CV_8UC3);
+        for (int y = 0; y < imgH_; ++y)
+        {
+            const unsigned char *in = camera + y * texWidth * 3;
+            unsigned char *out = postImage_.ptr(y);
+            if (!layer)
+            {
+                std::copy(in, in + imgW_ * 3, out);
+                continue;
+            }
             
+            const unsigned char *over = layer + y * texWidth * 4;
+            for (int x = 0; x < imgW_; ++x, in += 3, over += 4, out += 3)
+            {
+                int transparency = 255 - over[3];
+                for (int c = 0; c < 3; ++c) out[c] = over[c] + (in[c] * transparency + 127) / 255;
+            }
+        }
+        
+        // Write frame
+        {
             cv::Mat bgr_image;
-            cv::cvtColor(rgb_image, bgr_image, cv::COLOR_BGR2RGB);
+            cv::cvtColor(postImage_, bgr_image, cv::COLOR_BGR2RGB);
          
             // write to video
-            if (video_post.isOpened()) video_post << bgr_image;
+            if (video_post.isOpened() && session::policy().isRecording()) video_post << bgr_image;
 
-            // write a jog frame
-            {
-                std::string filename = outdir2_ + "/frame" + std::to_string(currentFrame_);
-                filename += ".jpeg";
-                cv::imwrite(filename, bgr_image, {CV_IMWRITE_JPEG_QUALITY, jpegQualitySetting});
-            }
+            // write a jpg frame
+            writeFrame(session::ChunkType::RgbPostJpeg, bgr_image, frameId, timestamp);
+        }
+    }
+    
+    void RGBFeed::writeFrame(session::ChunkType type, const cv::Mat &bgr_image, XnUInt32 frameId, XnUInt64 timestamp)
+    {
+        if (!session::output().isOpen()) return;
+        
+        if (cv::imencode(".jpeg", bgr_image, jpegBuf_, {CV_IMWRITE_JPEG_QUALITY, jpegQualitySetting}))
+        {
+            session::policy().append(type, frameId, timestamp, jpegBuf_.data(), jpegBuf_.size());
+        }
+    }
+    
+    void RGBFeed::writeUserCrops(const cv::Mat &bgr_image)
+    {
+        if (!session::output().isOpen()) return;
+        
+        xn::SceneMetaData smd;
+        if (sensor::userGenerator().GetUserPixels(0, smd) != XN_STATUS_OK) return;
+        
+        LabelBounds bounds[16];
+        int count = computeLabelBounds(smd.Data(), smd.XRes(), smd.YRes(), bounds, 16);
+        
+        // The label map comes from the depth generator and may not have the camera resolution
+        float sx = (float)imgW_ / smd.XRes();
+        float sy = (float)imgH_ / smd.YRes();
+        
+        // Nor its viewpoint: the depth camera sits 'roiBaseline_' beside the RGB one, so a user
+        // appears shifted sideways by focal * baseline / distance. The boxes are widened by that
+        // much on both sides, leaving the sensor's own registration alone.
+        XnFieldOfView fov = {};
+        sensor::depthGenerator().GetFieldOfView(fov);
+        float focal = fov.fHFOV > 0.0? imgW_ / (2.0f * tanf((float)fov.fHFOV * 0.5f)) : imgW_;
+        
+        for (int k = 0; k < count; ++k)
+        {
+            auto &b = bounds[k];
+            
+            XnPoint3D com = {};
+            sensor::userGenerator().GetCoM(b.label, com);
+            int parallax = (int)ceilf(focal * roiBaseline_ / std::max(com.Z, 500.0f));
+            
+            int x0 = std::max(0, (int)(b.minX * sx) - roiPadding_ - parallax);
+            int y0 = std::max(0, (int)(b.minY * sy) - roiPadding_);
+            int x1 = std::min(imgW_, (int)((b.maxX + 1) * sx) + roiPadding_ + parallax);
+            int y1 = std::min(imgH_, (int)((b.maxY + 1) * sy) + roiPadding_);
+            if (x1 <= x0 || y1 <= y0) continue;
+            
+            cv::Mat crop(bgr_image, cv::Rect(x0, y0, x1 - x0, y1 - y0));
+            if (!cv::imencode(".jpeg", crop, jpegBuf_, {CV_IMWRITE_JPEG_QUALITY, jpegQualitySetting})) continue;
+            
+            session::RoiHeader header = {};
+            header.userId = b.label;
+            header.x = x0;
+            header.y = y0;
+            header.width = x1 - x0;
+            header.height = y1 - y0;
+            header.frameWidth = imgW_;
+            header.frameHeight = imgH_;
+            
+            session::policy().append(session::ChunkType::RgbPreRoiJpeg, frameId_, timestamp_,
+                                     &header, sizeof(header), jpegBuf_.data(), jpegBuf_.size());
         }
-
     }
     
     
@@ -583,8 +979,11 @@ namespace gfx
 //
     RenderToTexture::~RenderToTexture()
     {
-        glDeleteRenderbuffers(1, &depthRenderBuffer);
-        glDeleteFramebuffers(1, &frameBuffer);
+        for (auto &entry : targets)
+        {
+            glDeleteRenderbuffers(1, &entry.second.depthRenderBuffer);
+            glDeleteFramebuffers(1, &entry.second.frameBuffer);
+        }
     }
     
     bool RenderToTexture::begin(DynamicTextureGenerator *target)
@@ -598,54 +997,140 @@ namespace gfx
         return begin((GLuint)target->platformHandle(), target->width(), target->height(), target->width(), target->height());
     }
     
+    bool RenderToTexture::beginOverlay(DynamicTextureGenerator *target)
+    {
+        auto *tex = target->getOverlay();
+        if (!tex) return false;
+        
+        // the generator reallocated its overlay: the framebuffer of the old one goes with it
+        GLuint &last = overlays[target];
+        if (last != 0 && last != (GLuint)tex->platformHandle()) release(last);
+        last = (GLuint)tex->platformHandle();
+        
+        if (!begin((GLuint)tex->platformHandle(), tex->width(), tex->height(), target->logicalWidth(), target->logicalHeight())) return false;
+        
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]); // the window's, see OpenGLHelper::init()
+        return true;
+    }
+    
     bool RenderToTexture::begin(GLuint target, int w, int h, int vw, int vh)
     {
-        if (frameBuffer == 0) // first run
-        {
-            glGenFramebuffers(1, &frameBuffer);
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-
-        if (depthRenderBuffer == 0 && bUseDepth)
+        Target &t = targets[target];
+        if (t.frameBuffer == 0 || w != t.width || h != t.height) // first run, or the texture was reallocated
         {
-            glGenRenderbuffers(1, &depthRenderBuffer);
-            glBindRenderbuffer(GL_RENDERBUFFER, depthRenderBuffer);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderBuffer);
-        }
-        if (bUseDepth && (w != width || h != height))
-        {
-            width = w;
-            height = h;
-            glBindRenderbuffer(GL_RENDERBUFFER, depthRenderBuffer);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+            if (t.frameBuffer == 0) glGenFramebuffers(1, &t.frameBuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, t.frameBuffer);
+            
+            if (bUseDepth)
+            {
+                if (t.depthRenderBuffer == 0) glGenRenderbuffers(1, &t.depthRenderBuffer);
+                glBindRenderbuffer(GL_RENDERBUFFER, t.depthRenderBuffer);
+                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, t.depthRenderBuffer);
+            }
+            
+            if (window::isLegacyOpenGL())
+                glFramebufferTextureEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, 0);
+            else
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, 0);
+            
+            GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+            glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers; part of the framebuffer's state
+            
+            t.width = w;
+            t.height = h;
+            t.bComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+            if (!t.bComplete) fprintf(stderr, "RenderToTexture: framebuffer of texture %u is incomplete\n", target);
         }
+        else glBindFramebuffer(GL_FRAMEBUFFER, t.frameBuffer);
         
-        if (window::isLegacyOpenGL())
-            glFramebufferTextureEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, 0);
-        else
-            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, 0);
-
-        GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-        glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
-
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+        if (!t.bComplete) return false;
         
         glViewport(0, 0, vw, vh);
         
         return true;
     }
     
-    void RenderToTexture::end()
+    void RenderToTexture::release(GLuint target)
     {
-        if (window::isLegacyOpenGL())
-            glFramebufferTextureEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0);
-        else
-            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0);
+        auto it = targets.find(target);
+        if (it == targets.end()) return;
         
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &it->second.depthRenderBuffer);
+        glDeleteFramebuffers(1, &it->second.frameBuffer);
+        targets.erase(it);
     }
     
-    
+    void RenderToTexture::end()
+    {
+        // the texture stays attached, for the next begin()
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+
+// GpuTimer
+//
+    GpuTimer::~GpuTimer()
+    {
+        if (bSupported_) glDeleteQueries(QueryCount, queries_);
+    }
+
+    void GpuTimer::begin()
+    {
+        if (!bInit_)
+        {
+            bInit_ = true;
+            bSupported_ = GLEW_VERSION_3_3 || GLEW_ARB_timer_query || GLEW_EXT_timer_query;
+            if (bSupported_) glGenQueries(QueryCount, queries_);
+        }
+        if (!bSupported_ || bRunning_) return;
+
+        collect();
+        if (pending_[next_]) return;    // every query still in flight: skip this one
+
+        glBeginQuery(GL_TIME_ELAPSED, queries_[next_]);
+        bRunning_ = true;
+    }
+
+    void GpuTimer::end()
+    {
+        if (!bRunning_) return;
+
+        glEndQuery(GL_TIME_ELAPSED);
+        pending_[next_] = true;
+        next_ = (next_ + 1) % QueryCount;
+        bRunning_ = false;
+    }
+
+    void GpuTimer::collect()
+    {
+        // oldest first, stopping at the first one not done yet
+        for (int k = 0; k < QueryCount; ++k)
+        {
+            int q = (next_ + k) % QueryCount;
+            if (!pending_[q]) continue;
+
+            GLint available = 0;
+            glGetQueryObjectiv(queries_[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            GLuint64 ns = 0;
+            if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query)
+                glGetQueryObjectui64v(queries_[q], GL_QUERY_RESULT, &ns);
+            else
+                glGetQueryObjectui64vEXT(queries_[q], GL_QUERY_RESULT, &ns);
+            pending_[q] = false;
+
+            lastMs_ = ns * 1e-6;
+            averageMs_ = averageMs_ * 0.95 + lastMs_ * 0.05;
+        }
+    }
+
+
 // gfx::drawString()
 //
 #if defined(USE_FONT_SIZE_32)
@@ -655,6 +1140,10 @@ namespace gfx
 #endif
     namespace
     {
+        // Strings are queued as quads into VertexData and drawn by flush(),
+        // all of them with one state setup and one glDrawElements. The index
+        // buffer grows to the largest frame seen; the vertices go through a
+        // StreamingBuffer, a region per frame.
         struct TextRenderer
         {
             static bool bError;
@@ -664,24 +1153,24 @@ namespace gfx
                 float x, y;
                 float u, v;
             };
-            static const int CharactersMax = 32;
-            static const int BufferVertexCountMax = CharactersMax * 4;
-            static Vertex VertexData[BufferVertexCountMax];
-
-            static const int BufferIndexCountMax = CharactersMax * 6;
+            static constexpr int InitialCharacters = 1024;
+            static std::vector<Vertex> VertexData;      // 4 per queued character
+            static int CharactersAllocated;             // capacity of IB; VB grows by itself
 
-            static bool bStatesSet;
-            
-            static std::unique_ptr<VertexBuffer> VB;
+            static std::unique_ptr<StreamingBuffer> VB;
             static std::unique_ptr<IndexBuffer> IB;
             static std::unique_ptr<Texture> FontTexture;
             static std::unique_ptr<Program> ShaderProgram;
             
-            static GLint texRectLoc;
+            static GLint texRectLoc, projectionLoc, positionLoc, texCoordLoc;
+            static GLuint VAO;                          // core profile only
+            
+            static TextStats Stats;
+            static int nStrings;
+            static double queueMs;                      // since the last flush
             
         private:
             static Font    *font;
-            static int     nCharactersToDraw;
             static int     x, y;
 
         public:
@@ -714,64 +1203,106 @@ namespace gfx
                 int sw = w * scale;
                 int sh = h * scale;
                 
-                Vertex *quad = &TextRenderer::VertexData[4 * nCharactersToDraw];
-                quad[0] = {f(x + ox),       f(y + oy),         f(u),       f(v)};
-                quad[1] = {f(x + sw + ox),  f(y + oy),         f(u + w),   f(v)};
-                quad[2] = {f(x + sw + ox),  f(y + sh + oy),    f(u + w),   f(v + h)};
-                quad[3] = {f(x + ox),       f(y + sh + oy),    f(u),       f(v + h)};
+                VertexData.push_back({f(x + ox),       f(y + oy),         f(u),       f(v)});
+                VertexData.push_back({f(x + sw + ox),  f(y + oy),         f(u + w),   f(v)});
+                VertexData.push_back({f(x + sw + ox),  f(y + sh + oy),    f(u + w),   f(v + h)});
+                VertexData.push_back({f(x + ox),       f(y + sh + oy),    f(u),       f(v + h)});
                 
                 //x += font->characters['W' - 32].width * scale;
                 x += (c == ' ')? font->characters['W' - 32].width * 0.5f * scale : sw;
-                
-                if (++nCharactersToDraw == TextRenderer::CharactersMax)
-                {
-                    drawChars();
-                }
             }
             
-            static void flush()
+            static void flush(float width, float height)
             {
-                if (nCharactersToDraw)
+                auto start = std::chrono::steady_clock::now();
+                
+                int nCharacters = (int)VertexData.size() / 4;
+                int drawCalls = 0;
+                if (nCharacters && setStates(nCharacters))
                 {
-                    drawChars();
+                    glEnable(GL_BLEND);
+                    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // see SkeletonRenderer::draw()
+                    
+                    float projection[16];
+                    orthoProjection(width, height, projection);
+                    glUniformMatrix4fv(TextRenderer::projectionLoc, 1, GL_FALSE, projection);
+                    
+                    // Written into the next region of the ring, so the draw never waits on the last frame's
+                    auto *dst = TextRenderer::VB->map<TextRenderer::Vertex>((uint32_t)VertexData.size());
+                    if (dst)
+                    {
+                        std::copy(VertexData.begin(), VertexData.end(), dst);
+                        size_t offset = TextRenderer::VB->unmap();
+                        
+    #define BUFFER_OFFSET(i) ((void*)(i))
+                        
+                        TextRenderer::VB->bind();
+                        glEnableVertexAttribArray(TextRenderer::positionLoc);
+                        glVertexAttribPointer(TextRenderer::positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(TextRenderer::Vertex), BUFFER_OFFSET(offset));      // The start of this frame's region, for the vertices
+                        glEnableVertexAttribArray(TextRenderer::texCoordLoc);
+                        glVertexAttribPointer(TextRenderer::texCoordLoc, 2, GL_FLOAT, GL_FALSE, sizeof(TextRenderer::Vertex), BUFFER_OFFSET(offset + 8)); // texcoords, 8 bytes away
+                        
+                        TextRenderer::IB->draw(6 * nCharacters);
+                        TextRenderer::VB->fence();
+                        drawCalls = 1;
+                    }
+                    
+                    glDisable(GL_BLEND);
+                    
+                    glDisableVertexAttribArray(TextRenderer::positionLoc);
+                    glDisableVertexAttribArray(TextRenderer::texCoordLoc);
+                    if (TextRenderer::VAO) glBindVertexArray(0);
+                    glBindBuffer(GL_ARRAY_BUFFER, 0);
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+                    glUseProgram(0);
                 }
+                
+                auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                Stats.strings = nStrings;
+                Stats.characters = nCharacters;
+                Stats.drawCalls = drawCalls;
+                Stats.averageMs = Stats.averageMs * 0.95 + (queueMs + elapsed) * 0.05;
+                
+                VertexData.clear();
+                nStrings = 0;
+                queueMs = 0.0;
             }
             
-            static bool setStates();
-            
-        private:
-            static void drawChars()
+            /** Builds what the first flush would (font texture, program, buffers) */
+            static bool prepare()
             {
-                if (!TextRenderer::bStatesSet)
-                {
-                    glEnable(GL_BLEND);
-                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                    //glEnable(GL_ALPHA_TEST);
-                    //glAlphaFunc(GL_GREATER, 0.4);
-                    
-                    TextRenderer::setStates();
-                    TextRenderer::bStatesSet = true;
-                }
-                TextRenderer::VB->updateData(TextRenderer::VertexData, 4 * nCharactersToDraw);
-                TextRenderer::IB->draw(6 * nCharactersToDraw);
-                nCharactersToDraw = 0;
+                if (!setStates(InitialCharacters)) return false;
+                
+                if (VAO) glBindVertexArray(0);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+                glUseProgram(0);
+                return true;
             }
+            
+        private:
+            static bool setStates(int nCharacters);
         };
         bool TextRenderer::bError = false;
-        TextRenderer::Vertex TextRenderer::VertexData[TextRenderer::BufferVertexCountMax];
-        bool TextRenderer::bStatesSet = false;
-        std::unique_ptr<VertexBuffer> TextRenderer::VB;
+        std::vector<TextRenderer::Vertex> TextRenderer::VertexData;
+        int TextRenderer::CharactersAllocated = 0;
+        std::unique_ptr<StreamingBuffer> TextRenderer::VB;
         std::unique_ptr<IndexBuffer> TextRenderer::IB;
         std::unique_ptr<Texture> TextRenderer::FontTexture;
         std::unique_ptr<Program> TextRenderer::ShaderProgram;
         GLint TextRenderer::texRectLoc;
+        GLint TextRenderer::projectionLoc;
+        GLint TextRenderer::positionLoc;
+        GLint TextRenderer::texCoordLoc;
+        GLuint TextRenderer::VAO = 0;
+        TextStats TextRenderer::Stats;
+        int TextRenderer::nStrings = 0;
+        double TextRenderer::queueMs = 0.0;
         
         Font *TextRenderer::font = &font_Helvetica;
-        int TextRenderer::nCharactersToDraw = 0;
         int TextRenderer::x;
         int TextRenderer::y;
 
-        bool TextRenderer::setStates()
+        bool TextRenderer::setStates(int nCharacters)
         {
             if (TextRenderer::bError) return false;
             
@@ -795,38 +1326,6 @@ namespace gfx
             TextRenderer::FontTexture->bind();
             
             
-            if (!TextRenderer::IB)
-            {
-                TextRenderer::IB = std::make_unique<IndexBuffer>();
-                ushort data[TextRenderer::BufferIndexCountMax];
-                for (int k = 0; k < TextRenderer::CharactersMax; ++k)
-                {
-                    ushort *face = &data[6 * k];
-                    ushort i = 4 * k;
-                    *face++ = i+0; *face++ = i+1; *face++ = i+2;
-                    *face++ = i+0; *face++ = i+2; *face++ = i+3;
-                }
-                TextRenderer::IB->init<gfx::IndexType::UShort>(TextRenderer::BufferIndexCountMax, BufferUsage::StaticDraw, data);
-            }
-            TextRenderer::IB->bind();
-            
-            
-            if (!TextRenderer::VB)
-            {
-                TextRenderer::VB = std::make_unique<VertexBuffer>();
-                TextRenderer::VB->init<TextRenderer::Vertex>(TextRenderer::BufferVertexCountMax, BufferUsage::StreamDraw);
-            }
-            TextRenderer::VB->bind();
-            
-    #define BUFFER_OFFSET(i) ((void*)(i))
-            
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(2, GL_FLOAT, sizeof(TextRenderer::Vertex), BUFFER_OFFSET(0));    // The starting point of the VBO, for the vertices
-            glClientActiveTexture(GL_TEXTURE0);
-            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            glTexCoordPointer(2, GL_FLOAT, sizeof(TextRenderer::Vertex), BUFFER_OFFSET(8)); // The starting point of texcoords, 8 bytes away
-            
-            
             if (!TextRenderer::ShaderProgram)
             {
                 TextRenderer::ShaderProgram = std::make_unique<Program>();
@@ -837,9 +1336,42 @@ namespace gfx
                 }
                 TextRenderer::ShaderProgram->bind();
                 TextRenderer::texRectLoc = TextRenderer::ShaderProgram->uniformLocation("texRect");
+                TextRenderer::projectionLoc = TextRenderer::ShaderProgram->uniformLocation("projection");
+                TextRenderer::positionLoc = glGetAttribLocation(TextRenderer::ShaderProgram->platformHandle(), "position");
+                TextRenderer::texCoordLoc = glGetAttribLocation(TextRenderer::ShaderProgram->platformHandle(), "texCoord");
+                
+                // core profile draws need a vertex array object
+                if (!window::isLegacyOpenGL()) glGenVertexArrays(1, &TextRenderer::VAO);
             }
             TextRenderer::ShaderProgram->bind();
             glUniform1i (TextRenderer::texRectLoc, 0);
+            if (TextRenderer::VAO) glBindVertexArray(TextRenderer::VAO);
+            
+            
+            if (!TextRenderer::IB || TextRenderer::CharactersAllocated < nCharacters)
+            {
+                int capacity = std::max(TextRenderer::InitialCharacters, 2 * TextRenderer::CharactersAllocated);
+                while (capacity < nCharacters) capacity *= 2;
+                TextRenderer::CharactersAllocated = capacity;
+                
+                std::vector<uint32_t> data(6 * capacity);
+                for (int k = 0; k < capacity; ++k)
+                {
+                    uint32_t *face = &data[6 * k];
+                    uint32_t i = 4 * k;
+                    *face++ = i+0; *face++ = i+1; *face++ = i+2;
+                    *face++ = i+0; *face++ = i+2; *face++ = i+3;
+                }
+                if (!TextRenderer::IB) TextRenderer::IB = std::make_unique<IndexBuffer>();
+                TextRenderer::IB->init<gfx::IndexType::Uint>(6 * capacity, BufferUsage::StaticDraw, data.data());
+                
+                if (!TextRenderer::VB)
+                {
+                    TextRenderer::VB = std::make_unique<StreamingBuffer>();
+                    TextRenderer::VB->init(4 * capacity * sizeof(TextRenderer::Vertex));
+                }
+            }
+            TextRenderer::IB->bind();
             
             return true;
         }
@@ -848,7 +1380,8 @@ namespace gfx
     {
         if (!TextRenderer::bError)
         {
-            TextRenderer::bStatesSet = false;
+            auto start = std::chrono::steady_clock::now();
+            
             TextRenderer::setXY(x, y);
             
             char *nextChar = const_cast<char *>(str);
@@ -856,22 +1389,38 @@ namespace gfx
             {
                 TextRenderer::drawChar(*nextChar++, scale);
             }
+            ++TextRenderer::nStrings;
             
-            TextRenderer::flush();
-            if (TextRenderer::bStatesSet)
-            {
-                glDisable(GL_BLEND);
-                //glDisable(GL_ALPHA_TEST);
-
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-                glUseProgram(0);
-                glDisableClientState(GL_VERTEX_ARRAY);
-                glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-            }
+            TextRenderer::queueMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         }
     }
     
+    void flushStrings(float width, float height)
+    {
+        TextRenderer::flush(width, height);
+    }
+    
+    bool prepareText()
+    {
+        return TextRenderer::prepare();
+    }
+    
+    void orthoProjection(float width, float height, float matrix[16])
+    {
+        const float m[16] = {
+            2.0f / width, 0.0f, 0.0f, 0.0f,
+            0.0f, 2.0f / height, 0.0f, 0.0f,
+            0.0f, 0.0f, -1.0f, 0.0f,
+            -1.0f, -1.0f, 0.0f, 1.0f
+        };
+        std::copy(m, m + 16, matrix);
+    }
+    
+    const TextStats &textStats()
+    {
+        return TextRenderer::Stats;
+    }
+    
 } // namespace gfx
 
 
@@ -0,0 +1,153 @@
+#include "recording_policy.hpp"
+
+#include <cstring>
+
+namespace session
+{
+// RecordingPolicy
+//
+    RecordingPolicy::RecordingPolicy(Writer &output)
+    : RecordingPolicy(output, Settings())
+    {
+    }
+
+    RecordingPolicy::RecordingPolicy(Writer &output, const Settings &settings)
+    : output_(output)
+    {
+        setSettings(settings);
+    }
+
+    void RecordingPolicy::setSettings(const Settings &settings)
+    {
+        while (count_ > 0) popOldest(true);
+
+        settings_ = settings;
+        std::vector<uint8_t>(settings_.bufferBytes).swap(bytes_);
+        std::vector<Entry>(settings_.bufferChunksMax).swap(entries_);
+        first_ = count_ = writePos_ = 0;
+    }
+
+    void RecordingPolicy::update(uint64_t timestamp, bool usersTracked, float handSpeed)
+    {
+        bool bActive = (settings_.bTriggerOnTrackedUsers && usersTracked) || handSpeed >= settings_.handSpeedThreshold;
+        if (bActive)
+        {
+            lastActiveTimestamp_ = timestamp;
+            bEverActive_ = true;
+        }
+
+        const uint64_t postRoll = (uint64_t)(settings_.postRollSeconds * 1e6);
+        bool bWantRecording = bEverActive_ && timestamp <= lastActiveTimestamp_ + postRoll;
+
+        if (bWantRecording && !bRecording_)
+        {
+            bRecording_ = true;
+            flush(); // pre-roll
+        }
+        else if (!bWantRecording)
+        {
+            bRecording_ = false;
+
+            const uint64_t preRoll = (uint64_t)(settings_.preRollSeconds * 1e6);
+            while (count_ > 0 && oldest().timestamp + preRoll < timestamp)
+            {
+                popOldest(true);
+            }
+        }
+    }
+
+    bool RecordingPolicy::append(ChunkType type, uint32_t frameId, uint64_t timestamp, const void *data, size_t size)
+    {
+        return append(type, frameId, timestamp, nullptr, 0, data, size);
+    }
+
+    bool RecordingPolicy::append(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                                 const void *header, size_t headerSize, const void *data, size_t size)
+    {
+        if (!output_.isOpen()) return false;
+
+        if (bRecording_)
+        {
+            return output_.append(type, frameId, timestamp, header, headerSize, data, size);
+        }
+        return buffer(type, frameId, timestamp, header, headerSize, data, size);
+    }
+
+    bool RecordingPolicy::buffer(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                                 const void *header, size_t headerSize, const void *data, size_t size)
+    {
+        const size_t n = headerSize + size;
+        if (n > bytes_.size() || entries_.empty())
+        {
+            stats_.bytesDropped += n;
+            return true;
+        }
+
+        // Find room right after the newest entry, wrapping to the start of the ring when the tail is too short.
+        size_t pos = writePos_;
+        if (pos + n > bytes_.size())
+        {
+            // the tail becomes unused, so everything stored there goes first (those are the oldest entries)
+            while (count_ > 0 && oldest().offset >= writePos_) popOldest(true);
+            pos = 0;
+        }
+        while (count_ > 0)
+        {
+            const Entry &e = oldest();
+            bool bOverlaps = e.offset < pos + n && pos < e.offset + e.size;
+            if (!bOverlaps && count_ < entries_.size()) break;
+
+            popOldest(true);
+        }
+
+        if (headerSize) memcpy(&bytes_[pos], header, headerSize);
+        if (size) memcpy(&bytes_[pos + headerSize], data, size);
+
+        Entry &e = entries_[(first_ + count_) % entries_.size()];
+        e.timestamp = timestamp;
+        e.offset = pos;
+        e.size = n;
+        e.frameId = frameId;
+        e.type = type;
+        ++count_;
+
+        writePos_ = pos + n;
+        stats_.bytesBuffered += n;
+        return true;
+    }
+
+    bool RecordingPolicy::flush()
+    {
+        bool bOk = true;
+        while (count_ > 0)
+        {
+            const Entry &e = oldest();
+            bOk = output_.append(e.type, e.frameId, e.timestamp, &bytes_[e.offset], e.size) && bOk;
+            stats_.bytesFlushed += e.size;
+            popOldest(false);
+        }
+        return bOk;
+    }
+
+    void RecordingPolicy::popOldest(bool bDropped)
+    {
+        const Entry &e = oldest();
+        stats_.bytesBuffered -= e.size;
+        if (bDropped) stats_.bytesDropped += e.size;
+
+        first_ = (first_ + 1) % entries_.size();
+        if (--count_ == 0)
+        {
+            first_ = writePos_ = 0;
+        }
+    }
+
+
+// Policy of the current run
+//
+    RecordingPolicy &policy()
+    {
+        static RecordingPolicy gPolicy(output());
+        return gPolicy;
+    }
+}
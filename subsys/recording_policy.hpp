@@ -0,0 +1,92 @@
+#ifndef recording_policy_hpp
+#define recording_policy_hpp
+
+#include "session.hpp"
+
+// Recording policy
+//
+// Sits between the producers of session chunks and the session writer.
+// While the scene is idle, chunks are kept in a fixed-size in-memory ring
+// holding the last 'preRollSeconds' of data. When activity starts (users
+// tracked or hands moving), the ring is flushed to disk followed by the live
+// chunks, until 'postRollSeconds' after the activity stopped.
+//
+namespace session
+{
+    class RecordingPolicy
+    {
+    public:
+        struct Settings
+        {
+            double preRollSeconds = 3.0;
+            double postRollSeconds = 5.0;
+            bool   bTriggerOnTrackedUsers = true;
+            float  handSpeedThreshold = 150.0f;     // pixels per second, see History::Speed()
+            size_t bufferBytes = 64 * 1024 * 1024;
+            size_t bufferChunksMax = 4096;
+        };
+
+        struct Stats
+        {
+            uint64_t bytesBuffered = 0;     // currently held in the ring
+            uint64_t bytesFlushed = 0;      // written to disk from the ring
+            uint64_t bytesDropped = 0;      // never written: aged out or evicted
+        };
+
+        explicit RecordingPolicy(Writer &output);
+        RecordingPolicy(Writer &output, const Settings &settings);
+
+        const Settings &settings() const { return settings_; }
+        void setSettings(const Settings &settings);
+
+        /** Evaluate the trigger, once per sensor frame. 'timestamp' is the sensor time in microseconds. */
+        void update(uint64_t timestamp, bool usersTracked, float handSpeed);
+
+        bool isRecording() const { return bRecording_; }
+
+        /** Whether appended chunks are kept: written while recording, held for the pre-roll otherwise */
+        bool isCapturing() const { return output_.isOpen() && (bRecording_ || (settings_.preRollSeconds > 0.0 && !bytes_.empty())); }
+        const Stats &stats() const { return stats_; }
+
+        /** Same contract as Writer::append(). Returns false only on a write error. */
+        bool append(ChunkType type, uint32_t frameId, uint64_t timestamp, const void *data, size_t size);
+        bool append(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                    const void *header, size_t headerSize, const void *data, size_t size);
+
+    private:
+        struct Entry
+        {
+            uint64_t timestamp;
+            size_t offset, size;
+            uint32_t frameId;
+            ChunkType type;
+        };
+
+        bool buffer(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                    const void *header, size_t headerSize, const void *data, size_t size);
+        bool flush();
+        void popOldest(bool bDropped);
+        Entry &oldest() { return entries_[first_]; }
+
+        Writer &output_;
+        Settings settings_;
+        Stats stats_;
+
+        bool bRecording_ = false;
+        uint64_t lastActiveTimestamp_ = 0;
+        bool bEverActive_ = false;
+
+        // Ring of entries over a ring of bytes, both allocated once
+        std::vector<uint8_t> bytes_;
+        std::vector<Entry> entries_;
+        size_t first_ = 0, count_ = 0;
+        size_t writePos_ = 0;
+    };
+
+
+// Policy of the current run, writing to session::output()
+//
+    RecordingPolicy &policy();
+}
+
+#endif /* recording_policy_hpp */
@@ -0,0 +1,590 @@
+#include "session.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <tuple>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+    using namespace session;
+
+// On-disk structures
+//
+    const char FileMagic[8] = {'H','A','R','S','E','S','S','\0'};
+    const char FooterMagic[8] = {'H','A','R','I','N','D','E','X'};
+    const uint32_t ChunkMagic = 0x4B4E4348; // "HCNK"
+    const uint32_t FormatVersion = 1;
+    const size_t PayloadAlignment = 8;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 16, "");
+
+    struct ChunkHeader
+    {
+        uint32_t magic;
+        uint16_t type;
+        uint16_t flags;
+        uint32_t frameId;
+        uint32_t payloadCrc;
+        uint64_t timestamp;
+        uint64_t payloadSize;
+        uint32_t reserved;
+        uint32_t headerCrc; // crc of all the fields above
+    };
+    static_assert(sizeof(ChunkHeader) == 40, "");
+
+    struct Footer
+    {
+        uint64_t indexOffset;
+        uint64_t indexCount;
+        uint32_t indexCrc;
+        uint32_t reserved;
+        char magic[8];
+    };
+    static_assert(sizeof(Footer) == 32, "");
+
+
+// CRC-32 (IEEE 802.3)
+//
+    struct CrcTable
+    {
+        uint32_t entries[256];
+
+        CrcTable()
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1)? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+                }
+                entries[n] = c;
+            }
+        }
+    } gCrcTable;
+
+    uint32_t crc32(const void *data, size_t size, uint32_t crc = 0)
+    {
+        auto *p = (const uint8_t *)data;
+        crc = ~crc;
+        while (size--)
+        {
+            crc = gCrcTable.entries[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    size_t paddingFor(uint64_t size)
+    {
+        return (PayloadAlignment - size % PayloadAlignment) % PayloadAlignment;
+    }
+
+    /** Reserve 'size' bytes of contiguous space up front. Only where the filesystem does it natively. */
+    bool preallocate(int fd, uint64_t size)
+    {
+#if defined(__APPLE__)
+        fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, (off_t)size, 0 };
+        if (::fcntl(fd, F_PREALLOCATE, &store) == -1)
+        {
+            store.fst_flags = F_ALLOCATEALL;
+            if (::fcntl(fd, F_PREALLOCATE, &store) == -1) return false;
+        }
+        return true;
+#elif defined(__linux__)
+        return ::fallocate(fd, 0, 0, (off_t)size) == 0;
+#else
+        (void)fd; (void)size;
+        return false; // posix_fallocate() may fall back to writing zeros
+#endif
+    }
+
+    /** Wait for the last writes of a segment, then give back the preallocated space it did not use */
+    void finishSegment(std::unique_ptr<AsyncWriter> io, int fd, uint64_t size)
+    {
+        io->drain();
+        if (io->hasError())
+        {
+            fprintf(stderr, "session::Writer: some writes failed, the segment will be recovered on open\n");
+        }
+        io.reset();
+
+        if (::ftruncate(fd, (off_t)size) != 0)
+        {
+            fprintf(stderr, "session::Writer: unable to truncate a segment to %llu bytes\n", (unsigned long long)size);
+        }
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    Writer gOutput;
+}
+
+
+namespace session
+{
+// Writer
+//
+    Writer::~Writer()
+    {
+        close();
+    }
+
+    bool Writer::open(const std::string &path)
+    {
+        close();
+
+        basePath_ = path;
+        if (basePath_.size() > 4 && basePath_.compare(basePath_.size() - 4, 4, ".har") == 0)
+        {
+            basePath_.resize(basePath_.size() - 4);
+        }
+
+        stats_ = Stats();
+        findSegments();
+        return openSegment();
+    }
+
+    void Writer::close()
+    {
+        if (fd_ >= 0) closeSegment(true);
+        if (finisher_.joinable()) finisher_.join();
+    }
+
+    bool Writer::openSegment()
+    {
+        enforceBudget(settings_.segmentBytes);
+
+        const std::string path = segmentPath(nextSegment_);
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+        bool bDirect = false;
+#ifdef O_DIRECT
+        if (settings_.bDirectIO)
+        {
+            fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            bDirect = fd_ >= 0; // not every filesystem supports it
+        }
+#endif
+        if (fd_ < 0)
+        {
+            fd_ = ::open(path.c_str(), flags, 0644);
+        }
+        if (fd_ < 0)
+        {
+            fprintf(stderr, "session::Writer::open(): Unable to create %s\n", path.c_str());
+            return false;
+        }
+#ifdef F_NOCACHE
+        if (settings_.bDirectIO)
+        {
+            ::fcntl(fd_, F_NOCACHE, 1);
+        }
+#endif
+
+        preallocated_ = preallocate(fd_, settings_.segmentBytes)? settings_.segmentBytes : 0;
+        stats_.segment = nextSegment_++;
+
+        AsyncWriter::Settings ioSettings;
+        if (bDirect)
+        {
+            ioSettings.alignment = 4096;
+        }
+        io_.reset(new AsyncWriter(ioSettings));
+
+        FileHeader header = {};
+        memcpy(header.magic, FileMagic, sizeof(header.magic));
+        header.version = FormatVersion;
+
+        offset_ = 0;
+        index_.clear();
+        return writeAll(&header, sizeof(header));
+    }
+
+    void Writer::closeSegment(bool bWait)
+    {
+        Footer footer = {};
+        footer.indexOffset = offset_;
+        footer.indexCount = index_.size();
+        footer.indexCrc = crc32(index_.data(), index_.size() * sizeof(ChunkInfo));
+        memcpy(footer.magic, FooterMagic, sizeof(footer.magic));
+
+        writeAll(index_.data(), index_.size() * sizeof(ChunkInfo));
+        writeAll(&footer, sizeof(footer));
+        io_->flush();
+
+        segments_.push_back({ segmentPath(stats_.segment), offset_ });
+        closedBytes_ += offset_;
+        preallocated_ = 0;
+
+        // Waiting for the disk happens on a helper thread when rotating, so recording does not stall
+        if (finisher_.joinable()) finisher_.join();
+        if (bWait)
+        {
+            finishSegment(std::move(io_), fd_, offset_);
+        }
+        else
+        {
+            finisher_ = std::thread(finishSegment, std::move(io_), fd_, offset_);
+        }
+
+        fd_ = -1;
+        offset_ = 0;
+        index_.clear();
+        stats_.bytesOnDisk = closedBytes_;
+    }
+
+    // Appends the segments named 'prefix'NNNNNN.har in 'dir' to 'found' as (mtime, path, size, number)
+    static void scanSegments(const std::string &dir, const std::string &prefix,
+                             std::vector<std::tuple<time_t, std::string, uint64_t, uint32_t>> &found)
+    {
+        DIR *d = ::opendir(dir.c_str());
+        if (!d) return;
+
+        while (struct dirent *entry = ::readdir(d))
+        {
+            unsigned number;
+            char extension[8];
+            const char *name = entry->d_name;
+            if (strncmp(name, prefix.c_str(), prefix.size()) != 0) continue;
+            if (sscanf(name + prefix.size(), "%6u.%7s", &number, extension) != 2 || strcmp(extension, "har") != 0) continue;
+
+            const std::string path = dir + name;
+            struct stat st;
+            if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            {
+                found.emplace_back(st.st_mtime, path, (uint64_t)st.st_size, number);
+            }
+        }
+        ::closedir(d);
+    }
+
+    void Writer::findSegments()
+    {
+        segments_.clear();
+        closedBytes_ = 0;
+        nextSegment_ = 0;
+
+        // 'basePath_' is <root>/<run>/<name>: every launch writes to a new run directory, so the
+        // segments of earlier runs are found in the sibling directories under <root>
+        std::string dir = "./", prefix = basePath_;
+        size_t slash = basePath_.rfind('/');
+        if (slash != std::string::npos)
+        {
+            dir = basePath_.substr(0, slash + 1);
+            prefix = basePath_.substr(slash + 1);
+        }
+        prefix += "-";
+
+        std::string root, run = dir.substr(0, dir.size() - 1);
+        slash = run.rfind('/');
+        if (slash != std::string::npos)
+        {
+            root = run.substr(0, slash + 1);
+            run = run.substr(slash + 1);
+        }
+        else
+        {
+            root = "./";
+        }
+
+        std::vector<std::tuple<time_t, std::string, uint64_t, uint32_t>> found;
+        scanSegments(dir, prefix, found);
+        for (auto &f : found)
+        {
+            nextSegment_ = std::max(nextSegment_, std::get<3>(f) + 1);
+        }
+
+        if (run != "." && run != "..")
+        {
+            if (DIR *d = ::opendir(root.c_str()))
+            {
+                while (struct dirent *entry = ::readdir(d))
+                {
+                    const char *name = entry->d_name;
+                    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || run == name) continue;
+                    scanSegments(root + name + "/", prefix, found);   // fails quietly on plain files
+                }
+                ::closedir(d);
+            }
+        }
+
+        // oldest first; run directories are named by their start time, which breaks mtime ties
+        std::sort(found.begin(), found.end());
+        for (auto &f : found)
+        {
+            segments_.push_back({ std::get<1>(f), std::get<2>(f) });
+            closedBytes_ += std::get<2>(f);
+        }
+    }
+
+    void Writer::enforceBudget(uint64_t incoming)
+    {
+        if (settings_.diskBudgetBytes == 0) return;
+
+        // the segment being written is never evicted, even if it alone is over budget
+        size_t evict = 0;
+        while (evict < segments_.size() && closedBytes_ + incoming > settings_.diskBudgetBytes)
+        {
+            ::unlink(segments_[evict].path.c_str());
+            closedBytes_ -= segments_[evict].size;
+            ++stats_.evictions;
+            ++evict;
+        }
+        segments_.erase(segments_.begin(), segments_.begin() + evict);
+    }
+
+    std::string Writer::segmentPath(uint32_t number) const
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "-%06u.har", number);
+        return basePath_ + suffix;
+    }
+
+    void Writer::flush()
+    {
+        if (fd_ >= 0) io_->flush();
+    }
+
+    AsyncWriter::Stats Writer::ioStats()
+    {
+        return io_? io_->stats() : AsyncWriter::Stats();
+    }
+
+    const char *Writer::ioBackend() const
+    {
+        return io_? io_->backendName() : "none";
+    }
+
+    bool Writer::append(ChunkType type, uint32_t frameId, uint64_t timestamp, const void *data, size_t size)
+    {
+        return append(type, frameId, timestamp, nullptr, 0, data, size);
+    }
+
+    bool Writer::append(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                        const void *payloadHeader, size_t payloadHeaderSize, const void *data, size_t size)
+    {
+        if (fd_ < 0) return false;
+
+        const uint64_t payloadSize = payloadHeaderSize + size;
+
+        // Rotate when the chunk and the grown index would not fit the segment any more
+        const uint64_t chunkBytes = sizeof(ChunkHeader) + payloadSize + paddingFor(payloadSize);
+        const uint64_t closingBytes = (index_.size() + 1) * sizeof(ChunkInfo) + sizeof(Footer);
+        if (!index_.empty() && offset_ + chunkBytes + closingBytes > settings_.segmentBytes)
+        {
+            closeSegment(false);
+            ++stats_.rotations;
+            if (!openSegment()) return false;
+        }
+
+        ChunkHeader header = {};
+        header.magic = ChunkMagic;
+        header.type = (uint16_t)type;
+        header.frameId = frameId;
+        header.payloadCrc = crc32(data, size, crc32(payloadHeader, payloadHeaderSize));
+        header.timestamp = timestamp;
+        header.payloadSize = payloadSize;
+        header.headerCrc = crc32(&header, offsetof(ChunkHeader, headerCrc));
+
+        ChunkInfo info = {};
+        info.timestamp = timestamp;
+        info.offset = offset_ + sizeof(header);
+        info.size = payloadSize;
+        info.frameId = frameId;
+        info.type = type;
+
+        static const uint8_t zeros[PayloadAlignment] = {};
+        if (!writeAll(&header, sizeof(header)) ||
+            !writeAll(payloadHeader, payloadHeaderSize) ||
+            !writeAll(data, size) ||
+            !writeAll(zeros, paddingFor(payloadSize)))
+        {
+            fail();
+            return false;
+        }
+
+        index_.push_back(info);
+        stats_.bytesOnDisk = closedBytes_ + std::max(preallocated_, offset_);
+        return true;
+    }
+
+    bool Writer::writeAll(const void *data, size_t size)
+    {
+        if (size == 0) return true;
+        if (!io_->write(fd_, offset_, data, size)) return false;
+
+        offset_ += size;
+        stats_.bytesWritten += size;
+        return true;
+    }
+
+    void Writer::fail()
+    {
+        fprintf(stderr, "session::Writer::append(): write failed, closing session\n");
+        io_.reset();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+
+// Reader
+//
+    Reader::~Reader()
+    {
+        close();
+    }
+
+    bool Reader::open(const std::string &path)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        size_ = st.st_size;
+        void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file referenced
+
+        if (mapping == MAP_FAILED)
+        {
+            size_ = 0;
+            return false;
+        }
+        base_ = (const uint8_t *)mapping;
+
+        auto *header = (const FileHeader *)base_;
+        if (memcmp(header->magic, FileMagic, sizeof(FileMagic)) != 0 || header->version != FormatVersion)
+        {
+            close();
+            return false;
+        }
+
+        bRecovered_ = !readIndex();
+        if (bRecovered_)
+        {
+            scanChunks();
+        }
+
+        // Order by time, keeping file order for equal timestamps
+        std::stable_sort(index_.begin(), index_.end(), [](const ChunkInfo &a, const ChunkInfo &b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        for (uint32_t k = 0; k < index_.size(); ++k)
+        {
+            auto t = (size_t)index_[k].type;
+            if (t >= byType_.size()) byType_.resize(t + 1);
+            byType_[t].push_back(k);
+        }
+
+        return true;
+    }
+
+    void Reader::close()
+    {
+        if (base_)
+        {
+            ::munmap(const_cast<uint8_t *>(base_), size_);
+            base_ = nullptr;
+        }
+        size_ = 0;
+        bRecovered_ = false;
+        index_.clear();
+        byType_.clear();
+    }
+
+    size_t Reader::seek(uint64_t timestamp) const
+    {
+        auto it = std::lower_bound(index_.begin(), index_.end(), timestamp, [](const ChunkInfo &info, uint64_t t) {
+            return info.timestamp < t;
+        });
+        return it == index_.end()? npos : (size_t)(it - index_.begin());
+    }
+
+    size_t Reader::seek(uint64_t timestamp, ChunkType type) const
+    {
+        auto t = (size_t)type;
+        if (t >= byType_.size()) return npos;
+
+        auto &positions = byType_[t];
+        auto it = std::lower_bound(positions.begin(), positions.end(), timestamp, [this](uint32_t pos, uint64_t ts) {
+            return index_[pos].timestamp < ts;
+        });
+        return it == positions.end()? npos : (size_t)*it;
+    }
+
+    bool Reader::readIndex()
+    {
+        if (size_ < sizeof(FileHeader) + sizeof(Footer)) return false;
+
+        Footer footerCopy; // a truncated file can leave the footer position unaligned
+        memcpy(&footerCopy, base_ + size_ - sizeof(Footer), sizeof(Footer));
+        const Footer *footer = &footerCopy;
+        if (memcmp(footer->magic, FooterMagic, sizeof(FooterMagic)) != 0) return false;
+
+        uint64_t indexBytes = footer->indexCount * sizeof(ChunkInfo);
+        if (footer->indexOffset < sizeof(FileHeader) ||
+            footer->indexOffset + indexBytes + sizeof(Footer) != size_) return false;
+
+        auto *entries = (const ChunkInfo *)(base_ + footer->indexOffset);
+        if (crc32(entries, indexBytes) != footer->indexCrc) return false;
+
+        index_.assign(entries, entries + footer->indexCount);
+        return true;
+    }
+
+    void Reader::scanChunks()
+    {
+        index_.clear();
+
+        uint64_t pos = sizeof(FileHeader);
+        while (pos + sizeof(ChunkHeader) <= size_)
+        {
+            auto *header = (const ChunkHeader *)(base_ + pos);
+            if (header->magic != ChunkMagic ||
+                header->headerCrc != crc32(header, offsetof(ChunkHeader, headerCrc))) break;
+
+            uint64_t payloadOffset = pos + sizeof(ChunkHeader);
+            if (header->payloadSize > size_ - payloadOffset) break; // truncated
+            if (header->payloadCrc != crc32(base_ + payloadOffset, header->payloadSize)) break;
+
+            ChunkInfo info = {};
+            info.timestamp = header->timestamp;
+            info.offset = payloadOffset;
+            info.size = header->payloadSize;
+            info.frameId = header->frameId;
+            info.type = (ChunkType)header->type;
+            index_.push_back(info);
+
+            pos = payloadOffset + header->payloadSize + paddingFor(header->payloadSize);
+        }
+    }
+
+
+// Session of the current run
+//
+    Writer &output()
+    {
+        return gOutput;
+    }
+}
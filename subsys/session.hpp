@@ -0,0 +1,236 @@
+#ifndef session_hpp
+#define session_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_writer.hpp"
+
+// Session container
+//
+// A session is a single append-only file holding every recorded stream:
+//
+//      FileHeader | Chunk* | IndexEntry* | Footer
+//
+// Each Chunk is a ChunkHeader followed by its payload, padded to 8 bytes so
+// payloads can be used in place from a memory mapping. The index and footer
+// are written when the session is closed. A session without a valid footer
+// (crash, power loss) is recovered by scanning the chunks and stopping at
+// the first one that fails its CRC.
+//
+// All values are stored little-endian.
+//
+namespace session
+{
+    enum class ChunkType : uint16_t
+    {
+        RgbPreJpeg = 1,     // camera frame, JPEG
+        RgbPostJpeg = 2,    // camera frame with overlay, JPEG
+        Depth = 3,          // raw XnDepthPixel map, DepthHeader + pixels
+        Skeleton = 4,       // SkeletonRecord
+        Event = 5,          // EventRecord
+        RgbPreRoiJpeg = 6   // crop of a camera frame around one user, RoiHeader + JPEG
+    };
+
+
+// Payload records
+//
+    struct DepthHeader
+    {
+        uint16_t width;
+        uint16_t height;
+        uint32_t reserved;
+    };
+
+    struct RoiHeader
+    {
+        uint32_t userId;
+        uint16_t x, y, width, height;       // crop rectangle in the camera frame
+        uint16_t frameWidth, frameHeight;   // camera frame size
+    };
+
+    struct SkeletonJoint
+    {
+        float x, y, z;      // world position in millimeters
+        float confidence;
+    };
+
+    struct SkeletonRecord
+    {
+        static const int JointCount = 24; // XN_SKEL_HEAD (1) ... XN_SKEL_RIGHT_FOOT (24)
+
+        uint32_t userId;
+        uint32_t jointCount;
+        SkeletonJoint joints[JointCount]; // indexed by XnSkeletonJoint - 1
+    };
+
+    struct EventRecord
+    {
+        uint32_t message;   // sensor::Message
+        uint32_t userId;
+    };
+
+
+// Chunk description, as kept in the index
+//
+    struct ChunkInfo
+    {
+        uint64_t timestamp; // sensor timestamp in microseconds
+        uint64_t offset;    // file offset of the payload
+        uint64_t size;      // payload size in bytes
+        uint32_t frameId;
+        ChunkType type;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(ChunkInfo) == 32, "ChunkInfo is written to disk as is!");
+
+
+// Writer
+//
+// Writes go through an AsyncWriter, so append() only copies the chunk into a
+// staging buffer and never waits on the disk.
+//
+// The output is a series of segments, 'name-000000.har', 'name-000001.har'...
+// next to the path given to open(). Each segment is a complete session file,
+// preallocated to 'segmentBytes' when created and truncated to its real size
+// when closed. Each run writes to its own directory, e.g. 'output/<time>/', so
+// the segments of this name in the sibling run directories are counted too;
+// once they all would exceed 'diskBudgetBytes', the oldest ones are deleted.
+//
+    class Writer
+    {
+    public:
+        struct Settings
+        {
+            uint64_t segmentBytes = 1024ull * 1024 * 1024;
+            uint64_t diskBudgetBytes = 20ull * 1024 * 1024 * 1024; // 0 for no limit
+            bool     bDirectIO = false;     // O_DIRECT on Linux, F_NOCACHE on macOS
+        };
+
+        struct Stats
+        {
+            uint64_t bytesWritten = 0;      // by this run, all segments
+            uint64_t bytesOnDisk = 0;       // all segments, the current one at its preallocated size
+            uint32_t segment = 0;           // number of the current segment
+            uint64_t rotations = 0;
+            uint64_t evictions = 0;
+        };
+
+        Writer() {}
+        ~Writer();
+
+        /** Takes effect on the next segment */
+        void setSettings(const Settings &settings) { settings_ = settings; }
+        const Settings &settings() const { return settings_; }
+
+        /** 'path' names the session, e.g. "out/session.har" for "out/session-000000.har"... */
+        bool open(const std::string &path);
+        void close();
+
+        bool isOpen() const { return fd_ >= 0; }
+
+        bool append(ChunkType type, uint32_t frameId, uint64_t timestamp, const void *data, size_t size);
+
+        /** Payload is 'header' followed by 'data', written without concatenating them first */
+        bool append(ChunkType type, uint32_t frameId, uint64_t timestamp,
+                    const void *header, size_t headerSize, const void *data, size_t size);
+
+        /** Submit the chunks appended so far, once per frame. Does not wait. */
+        void flush();
+
+        uint64_t bytesWritten() const { return stats_.bytesWritten; }
+        size_t chunkCount() const { return index_.size(); }
+        const Stats &stats() const { return stats_; }
+
+        /** Disk throughput and buffering of the open session */
+        AsyncWriter::Stats ioStats();
+        const char *ioBackend() const;
+
+    private:
+        Writer(const Writer &) = delete;
+        Writer &operator= (const Writer &) = delete;
+
+        struct Segment
+        {
+            std::string path;
+            uint64_t size;
+        };
+
+        bool openSegment();
+        void closeSegment(bool bWait);
+        void findSegments();
+        void enforceBudget(uint64_t incoming);
+        std::string segmentPath(uint32_t number) const;
+
+        bool writeAll(const void *data, size_t size);
+        void fail();
+
+        Settings settings_;
+        Stats stats_;
+        std::string basePath_;
+        std::vector<Segment> segments_;     // closed segments, oldest first
+        uint64_t closedBytes_ = 0;
+        uint32_t nextSegment_ = 0;
+        uint64_t preallocated_ = 0;
+        std::thread finisher_;              // completes the previous segment after a rotation
+
+        int fd_ = -1;
+        uint64_t offset_ = 0;
+        std::vector<ChunkInfo> index_;
+        std::unique_ptr<AsyncWriter> io_;
+    };
+
+
+// Reader
+//
+    class Reader
+    {
+    public:
+        static const size_t npos = (size_t)-1;
+
+        Reader() {}
+        ~Reader();
+
+        bool open(const std::string &path);
+        void close();
+
+        /** True when the footer was missing or damaged and the index was rebuilt by scanning */
+        bool isRecovered() const { return bRecovered_; }
+
+        /** Chunks are ordered by timestamp */
+        size_t chunkCount() const { return index_.size(); }
+        const ChunkInfo &chunk(size_t i) const { return index_[i]; }
+
+        /** Index of the first chunk with timestamp >= 'timestamp', or npos. O(log n) */
+        size_t seek(uint64_t timestamp) const;
+        size_t seek(uint64_t timestamp, ChunkType type) const;
+
+        /** Pointer into the mapped file, valid until close(). No copy is made. */
+        const void *payload(size_t i) const { return base_ + index_[i].offset; }
+
+    private:
+        Reader(const Reader &) = delete;
+        Reader &operator= (const Reader &) = delete;
+
+        bool readIndex();
+        void scanChunks();
+
+        const uint8_t *base_ = nullptr;
+        size_t size_ = 0;
+        bool bRecovered_ = false;
+
+        std::vector<ChunkInfo> index_;
+        std::vector<std::vector<uint32_t>> byType_; // per ChunkType, positions into index_
+    };
+
+
+// Session of the current run, opened by the application
+//
+    Writer &output();
+}
+
+#endif /* session_hpp */
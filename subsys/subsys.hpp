@@ -39,6 +39,8 @@
 /* other */
 #include "windowbase.hpp"
 #include "utils.hpp"
+#include "session.hpp"
+#include "recording_policy.hpp"
 #include "imgui_internal.h"
 //#include "imgui_tabs.h"
 
@@ -116,6 +118,7 @@ namespace gfx
             Rgb8,
             Bgra8,
             Bgr8,
+            Rgba8,
             L8
         };
         
@@ -230,7 +233,71 @@ namespace gfx
         size_t vertexSize_;
     };
 
-    
+
+// Streaming buffer
+//
+//  Vertex data rewritten every frame, without waiting for the GPU to finish
+//  reading what was written before. The buffer is a ring of 'regionCount'
+//  regions; each write goes to the next region, and a fence placed after the
+//  draws that read a region is waited on before the region is written again,
+//  which in practice never blocks. Depending on the context:
+//   - Persistent: mapped once, persistent and coherent (GL 4.4 or
+//     ARB_buffer_storage); writes go straight to the buffer
+//   - Unsynchronized: each region is mapped unsynchronized and unmapped after
+//     the write (core 3.2+ without buffer storage, e.g. macOS)
+//   - Orphan: no fences (legacy contexts); the whole buffer is orphaned and
+//     mapped from the start every time
+//
+//  Usage: p = map<V>(count); fill p; offset = unmap(); draw with the vertex
+//  attributes at 'offset' bytes; fence().
+//
+    class StreamingBuffer
+    {
+    public:
+        enum class Mode { Persistent, Unsynchronized, Orphan };
+
+        StreamingBuffer() {}
+        ~StreamingBuffer();
+
+        /** Room for 'regionSize' bytes per write; grows on demand in map() */
+        bool init(size_t regionSize, int regionCount = 3);
+
+        template <typename Vertex>
+        Vertex *map(uint32_t count) { return (Vertex *)mapBytes(count * sizeof(Vertex)); }
+
+        /** Finishes the write; returns its offset in the buffer, in bytes */
+        size_t unmap();
+
+        /** After the draws reading the last write were issued */
+        void fence();
+
+        void bind() { glBindBuffer(GL_ARRAY_BUFFER, vbo_); }
+
+        uint32_t platformHandle() const { return vbo_; }
+        Mode mode() const { return mode_; }
+        size_t regionSize() const { return regionSize_; }
+        int waits() const { return waits_; }   // writes that found their region still in use
+
+    private:
+        StreamingBuffer(StreamingBuffer &) = delete;
+        StreamingBuffer &operator= (StreamingBuffer &) = delete;
+
+        void *mapBytes(size_t size);
+        void release();
+
+        static const int MaxRegions = 4;
+
+        GLuint vbo_ = 0;
+        Mode mode_ = Mode::Orphan;
+        size_t regionSize_ = 0;
+        int regionCount_ = 0;
+        int region_ = -1;                   // being written, or last written
+        char *persistent_ = nullptr;        // Persistent: the whole buffer
+        GLsync fences_[MaxRegions] = {};
+        int waits_ = 0;
+    };
+
+
 // Index buffer
 //
     enum IndexType { UByte, UShort, Uint };
@@ -309,6 +376,11 @@ namespace gfx
     
     
 // Program
+//
+//  Built from 'shaderName'.shader. Where the driver can return program
+//  binaries, the linked program is kept in ./output/shader-cache/ under a hash
+//  of its sources and of the driver strings, and later runs load it instead
+//  of compiling and linking again.
 //
     class Program
     {
@@ -350,8 +422,12 @@ namespace gfx
         ImVec2 getUV1() { return uv1; }
         ImVec2 getUV2() { return uv2; }
         
+        /** Transparent layer the size of the texture, drawn over it when shown; created on first use, nullptr before the texture */
+        Texture *getOverlay();
+        
     protected:
         Texture tex_;
+        Texture overlay_;   // premultiplied color
         ImVec2 uv1, uv2;
     };
     
@@ -378,6 +454,12 @@ namespace gfx
     class RGBFeed : public DynamicTextureGenerator
     {
     public:
+        enum class RecordingMode
+        {
+            FullFrame,  // rgb_pre frames are stored whole
+            UserRoi     // rgb_pre frames are stored as padded crops around each user
+        };
+        
         RGBFeed();
         ~RGBFeed();
         
@@ -386,19 +468,53 @@ namespace gfx
         int logicalHeight() override { return (int)bottomRightY; }
         
     public:
+        /** Composite the overlay layer being drawn over the camera frame, for rgb_post. Read back a frame late. */
         void captureFramebuffer();
         
+        /** rgb_post without the overlay, when its layer could not be drawn */
+        void capturePlainFrame();
+        
+        RecordingMode recordingMode() const { return recordingMode_; }
+        void setRecordingMode(RecordingMode mode) { recordingMode_ = mode; }
+        
     private:
+        bool isWritingPost() const;
+        void writePost(const unsigned char *layer, const unsigned char *camera, XnUInt32 frameId, XnUInt64 timestamp);
+        void writeFrame(session::ChunkType type, const cv::Mat &bgr_image, XnUInt32 frameId, XnUInt64 timestamp);
+        void writeUserCrops(const cv::Mat &bgr_image);
+        
+        RecordingMode recordingMode_ = RecordingMode::FullFrame;
+        int roiPadding_ = 24; // pixels around each user box
+        float roiBaseline_ = 25.0f; // millimeters between the depth and RGB cameras
+        
         float topLeftX, topLeftY, bottomRightY, bottomRightX, texXpos, texYpos;
         std::vector<unsigned char> imageTexBuf_;
+        std::vector<unsigned char> overlayBuf_;     // read back from the overlay, for rgb_post, without PBOs
+        
+        // rgb_post readback: two pixel buffers, one being filled by the GPU while the other is composited
+        struct PendingPost
+        {
+            bool bPending = false;
+            XnUInt32 frameId = 0;
+            XnUInt64 timestamp = 0;
+            std::vector<unsigned char> camera;      // the camera frame the overlay was drawn over
+        };
+        GLuint postPbos_[2] = {};
+        PendingPost postPending_[2];
+        int postNext_ = 0;
+        
+        cv::Mat postImage_;
         bool bInit = false;
         unsigned int texWidth, texHeight;
         
-        std::string outdir_, outdir2_;
-
         int imgW_, imgH_;
-        int currentFrame_ = 0;
+        XnUInt32 frameId_ = 0;
+        XnUInt32 uploadedFrameId_ = (XnUInt32)-1;   // in tex_ already
+        XnUInt32 writtenFrameId_ = (XnUInt32)-1;    // rgb_pre in the session/video already
+        XnUInt32 postFrameId_ = (XnUInt32)-1;       // rgb_post in the session/video already
+        XnUInt64 timestamp_ = 0;
         int jpegQualitySetting = 50; // 95
+        std::vector<uchar> jpegBuf_;
 
         cv::VideoWriter video_pre;
         cv::VideoWriter video_post;
@@ -406,12 +522,22 @@ namespace gfx
     
     
 // RenderToTexture
+//
+//  Keeps a framebuffer object per target texture, with the texture attached
+//  and its completeness checked once, the first time the texture is drawn
+//  into (or when its size changes). begin() then only binds it.
 //
     class RenderToTexture
     {
-        GLuint frameBuffer = 0;
-        GLuint depthRenderBuffer = 0;
-        int width = 0, height = 0;
+        struct Target
+        {
+            GLuint frameBuffer = 0;
+            GLuint depthRenderBuffer = 0;
+            int width = 0, height = 0;
+            bool bComplete = false;
+        };
+        std::map<GLuint, Target> targets;   // by texture
+        std::map<DynamicTextureGenerator *, GLuint> overlays;  // overlay texture last drawn into, by generator
         const bool bUseDepth;
         
     public:
@@ -421,16 +547,77 @@ namespace gfx
         
         bool begin(DynamicTextureGenerator *target);
         bool begin(Texture *target);
+        bool beginOverlay(DynamicTextureGenerator *target);    // cleared to transparent
         void end();
         
     private:
         bool begin(GLuint target, int w, int h, int vw, int vh);
+        void release(GLuint target);
     };
-    
-    
+
+
+// GPU timer
+//
+//  GPU time of the commands issued between begin() and end(), measured with
+//  GL_TIME_ELAPSED queries (GL 3.3, ARB_timer_query or EXT_timer_query).
+//  Results are read a few frames late from a ring of queries, and only once
+//  available, so measuring never stalls the pipeline. Timers cannot nest.
+//  Without timer queries begin() and end() do nothing and the time stays 0.
+//
+    class GpuTimer
+    {
+    public:
+        GpuTimer() {}
+        ~GpuTimer();
+
+        void begin();
+        void end();
+
+        bool supported() const { return bSupported_; }
+        double lastMs() const { return lastMs_; }
+        double averageMs() const { return averageMs_; }
+
+    private:
+        GpuTimer(GpuTimer &) = delete;
+        GpuTimer &operator= (GpuTimer &) = delete;
+
+        void collect();
+
+        static const int QueryCount = 4;
+
+        GLuint queries_[QueryCount] = {};
+        bool pending_[QueryCount] = {};
+        int next_ = 0;
+        bool bInit_ = false;
+        bool bSupported_ = false;
+        bool bRunning_ = false;
+        double lastMs_ = 0.0;
+        double averageMs_ = 0.0;
+    };
+
+
 // Functions
 //
+    /** Queues a string at window position x, y; nothing is drawn until flushStrings() */
     void drawString(int x, int y, const char *str, float scale=1.0f);
+    
+    /** Draws every string queued since the last flush, in a width x height view, in one draw call */
+    void flushStrings(float width, float height);
+    
+    struct TextStats
+    {
+        int strings = 0;            // drawn by the last flush
+        int characters = 0;
+        int drawCalls = 0;
+        double averageMs = 0.0;     // CPU time to queue and draw a flush worth of strings
+    };
+    const TextStats &textStats();
+    
+    /** Loads the font and builds the text program now, at startup, instead of at the first flushStrings() */
+    bool prepareText();
+    
+    /** Column major glOrtho(0, width, 0, height, -1, 1), for the projection uniform of overlay shaders */
+    void orthoProjection(float width, float height, float matrix[16]);
 }
 
 #pragma GCC visibility pop
@@ -1,8 +1,11 @@
 #include "utils.hpp"
+#include <cstring>
+#include <algorithm>
 
 std::string OutputData::PostFix;
 std::string OutputData::CsvExtension;
 std::string OutputData::OutputDir = "./";
+const std::string OutputData::OutputRoot = "./output/";
 
 
 unsigned int getClosestPowerOfTwo(unsigned int n)
@@ -12,3 +15,57 @@ unsigned int getClosestPowerOfTwo(unsigned int n)
     
     return m;
 }
+
+int computeLabelBounds(const uint16_t *labels, int width, int height, LabelBounds *bounds, int maxBounds)
+{
+    const int LabelsMax = 16; // OpenNI user ids are small; larger labels are ignored
+    int minX[LabelsMax], minY[LabelsMax], maxX[LabelsMax], maxY[LabelsMax];
+    for (int k = 0; k < LabelsMax; ++k)
+    {
+        minX[k] = minY[k] = INT32_MAX;
+        maxX[k] = maxY[k] = -1;
+    }
+    
+    auto addPixel = [&](uint16_t label, int x, int y)
+    {
+        if (label == 0 || label >= LabelsMax) return;
+        
+        minX[label] = std::min(minX[label], x);
+        maxX[label] = std::max(maxX[label], x);
+        minY[label] = std::min(minY[label], y);
+        maxY[label] = std::max(maxY[label], y);
+    };
+    
+    // Most of the map is background, so test 4 labels at a time and only look
+    // at individual pixels of the words that are not all zero.
+    for (int y = 0; y < height; ++y)
+    {
+        const uint16_t *row = labels + (size_t)y * width;
+        
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            uint64_t word;
+            memcpy(&word, row + x, sizeof(word));
+            if (word == 0) continue;
+            
+            addPixel(row[x + 0], x + 0, y);
+            addPixel(row[x + 1], x + 1, y);
+            addPixel(row[x + 2], x + 2, y);
+            addPixel(row[x + 3], x + 3, y);
+        }
+        for (; x < width; ++x)
+        {
+            addPixel(row[x], x, y);
+        }
+    }
+    
+    int count = 0;
+    for (int k = 1; k < LabelsMax && count < maxBounds; ++k)
+    {
+        if (maxX[k] < 0) continue;
+        
+        bounds[count++] = { (uint16_t)k, minX[k], minY[k], maxX[k], maxY[k] };
+    }
+    return count;
+}
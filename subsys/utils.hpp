@@ -2,6 +2,7 @@
 #define utils_hpp
 
 #include <fstream>
+#include <cstdint>
 #include <time.h>
 #include <string>
 #include <sstream>
@@ -11,6 +12,16 @@
 //
 unsigned int getClosestPowerOfTwo(unsigned int n);
 
+/** Bounding box of the pixels carrying one label, inclusive */
+struct LabelBounds
+{
+    uint16_t label;
+    int minX, minY, maxX, maxY;
+};
+
+/** Bounding boxes of all non-zero labels of a label map, in one pass. Returns the number of boxes written. */
+int computeLabelBounds(const uint16_t *labels, int width, int height, LabelBounds *bounds, int maxBounds);
+
 
 // Classes
 //
@@ -33,8 +44,7 @@ public:
         
         CsvExtension = ".csv";
         
-        OutputDir = "./output/";
-        OutputDir += PostFix;
+        OutputDir = OutputRoot + PostFix;
         
         boost::filesystem::create_directory(OutputDir);
         OutputDir += "/";
@@ -80,11 +90,15 @@ public:
     
     static const std::string &GetOutputDir() { return OutputDir; }
     
+    /** Parent of every run directory, for data shared across runs */
+    static const std::string &GetOutputRoot() { return OutputRoot; }
+    
 private:
     static std::string PostFix;
     static std::string CsvExtension;
     
     static std::string OutputDir;
+    static const std::string OutputRoot;
 };
 
 #endif /* utils_hpp */
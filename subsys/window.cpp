@@ -50,6 +50,7 @@ namespace
             
             glfwMakeContextCurrent(win);
             
+            glewExperimental = GL_TRUE; // otherwise GLEW leaves core profile entry points (VAOs, ...) unloaded
             if (GLenum err = glewInit(); err != GLEW_OK)
             {
                 fprintf(stderr, "GLEW error: %s", glewGetErrorString(err));